@@ -0,0 +1,199 @@
+/**
+ * @file batchFitness.cpp
+ * @author Ondrej
+ * @brief Scores whole blocks of a population at once, vectorised when the CPU supports it
+ *
+*/
+
+#include "batchFitness.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_FITNESS_X86
+#endif
+
+namespace
+{
+  /** Scores one genome of any gene width with the column and diagonal histograms (see ConflictCounter) */
+  template <typename Gene>
+  size_t histogramConflicts(const Gene * genes, size_t N)
+  {
+    // Columns, main diagonals and anti-diagonals in one buffer that is reused by the thread
+    static thread_local std::vector<uint32_t> lines;
+    lines.assign(5 * N, 0);
+    uint32_t * columns = lines.data();
+    uint32_t * diagonals = columns + N;
+    uint32_t * antiDiagonals = diagonals + 2 * N;
+
+    size_t conflicts = 0;
+    for (size_t row = 0; row < N; row ++)
+    {
+      size_t column = genes[row];
+      conflicts += columns[column] ++;
+      conflicts += diagonals[row + N - 1 - column] ++;
+      conflicts += antiDiagonals[row + column] ++;
+    }
+
+    return conflicts;
+  }
+
+#ifdef BATCH_FITNESS_X86
+  /* Vectorised kernels count the pairs instead of filling histograms. Line values of queen i (column, column - row
+     and column + row, modulo 256) sit in byte lane i, the vector is compared with itself rotated by k lanes
+     (cyclically within N) for k = 1 .. N / 2, so every pair of queens is compared exactly once. Everything stays
+     in registers, the rotation is a byte shuffle */
+
+  /** Pairwise kernel of two boards with N <= 16, one board in each 128-bit half */
+  __attribute__((target("avx2,popcnt")))
+  void avx2Conflicts16(const uint8_t * genes1, const uint8_t * genes2, size_t N, double * fitness)
+  {
+    alignas(32) uint8_t buffer[32] = {};
+    std::memcpy(buffer, genes1, N);
+    std::memcpy(buffer + 16, genes2, N);
+
+    const __m256i rows = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                          0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i columns = _mm256_load_si256(reinterpret_cast<const __m256i *>(buffer));
+    const __m256i diagonals = _mm256_sub_epi8(columns, rows);
+    const __m256i antiDiagonals = _mm256_add_epi8(columns, rows);
+    const __m256i wrap = _mm256_set1_epi8(static_cast<char>(N));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(N - 1));
+
+    // Lanes of the boards, for k = N / 2 only the first half (the rest are the same pairs again)
+    uint32_t lanes = (1u << N) - 1;
+    uint32_t halfLanes = (1u << (N / 2)) - 1;
+    lanes |= lanes << 16;
+    halfLanes |= halfLanes << 16;
+
+    size_t conflicts1 = 0;
+    size_t conflicts2 = 0;
+    __m256i rotation = rows;
+    for (size_t k = 1; 2 * k <= N; k ++)
+    {
+      rotation = _mm256_add_epi8(rotation, _mm256_set1_epi8(1));
+      rotation = _mm256_sub_epi8(rotation, _mm256_and_si256(_mm256_cmpgt_epi8(rotation, last), wrap));
+
+      uint32_t valid = 2 * k == N ? halfLanes : lanes;
+      uint32_t columnMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(columns, _mm256_shuffle_epi8(columns, rotation))) & valid;
+      uint32_t diagonalMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(diagonals, _mm256_shuffle_epi8(diagonals, rotation))) & valid;
+      uint32_t antiMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(antiDiagonals, _mm256_shuffle_epi8(antiDiagonals, rotation))) & valid;
+
+      conflicts1 += _mm_popcnt_u32(columnMask & 0xFFFF) + _mm_popcnt_u32(diagonalMask & 0xFFFF) + _mm_popcnt_u32(antiMask & 0xFFFF);
+      conflicts2 += _mm_popcnt_u32(columnMask >> 16) + _mm_popcnt_u32(diagonalMask >> 16) + _mm_popcnt_u32(antiMask >> 16);
+    }
+
+    fitness[0] = conflicts1;
+    fitness[1] = conflicts2;
+  }
+
+  /** Pairwise kernel of one board with N <= 16 */
+  __attribute__((target("sse4.2,popcnt")))
+  size_t sse42Conflicts16(const uint8_t * genes, size_t N)
+  {
+    alignas(16) uint8_t buffer[16] = {};
+    std::memcpy(buffer, genes, N);
+
+    const __m128i rows = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i columns = _mm_load_si128(reinterpret_cast<const __m128i *>(buffer));
+    const __m128i diagonals = _mm_sub_epi8(columns, rows);
+    const __m128i antiDiagonals = _mm_add_epi8(columns, rows);
+    const __m128i wrap = _mm_set1_epi8(static_cast<char>(N));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(N - 1));
+
+    const uint32_t lanes = (1u << N) - 1;
+    const uint32_t halfLanes = (1u << (N / 2)) - 1;
+
+    size_t conflicts = 0;
+    __m128i rotation = rows;
+    for (size_t k = 1; 2 * k <= N; k ++)
+    {
+      rotation = _mm_add_epi8(rotation, _mm_set1_epi8(1));
+      rotation = _mm_sub_epi8(rotation, _mm_and_si128(_mm_cmpgt_epi8(rotation, last), wrap));
+
+      uint32_t valid = 2 * k == N ? halfLanes : lanes;
+      conflicts += _mm_popcnt_u32(_mm_movemask_epi8(_mm_cmpeq_epi8(columns, _mm_shuffle_epi8(columns, rotation))) & valid);
+      conflicts += _mm_popcnt_u32(_mm_movemask_epi8(_mm_cmpeq_epi8(diagonals, _mm_shuffle_epi8(diagonals, rotation))) & valid);
+      conflicts += _mm_popcnt_u32(_mm_movemask_epi8(_mm_cmpeq_epi8(antiDiagonals, _mm_shuffle_epi8(antiDiagonals, rotation))) & valid);
+    }
+
+    return conflicts;
+  }
+#endif
+}
+
+/** Returns the best instruction set supported by the CPU (detected once at startup) */
+FitnessIsa detectFitnessIsa(void)
+{
+#ifdef BATCH_FITNESS_X86
+  static const FitnessIsa isa = [] ()
+  {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+      return FitnessIsa::AVX2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+      return FitnessIsa::SSE42;
+    return FitnessIsa::Scalar;
+  }();
+  return isa;
+#else
+  return FitnessIsa::Scalar;
+#endif
+}
+
+/** Returns name of the instruction set */
+const char * fitnessIsaName(FitnessIsa isa)
+{
+  switch (isa)
+  {
+    case FitnessIsa::AVX2:
+      return "avx2";
+    case FitnessIsa::SSE42:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
+
+/** Scores individuals [begin, end) of the population into fitness[0, end - begin) */
+void evaluateConflicts(const Population & population, size_t begin, size_t end, double * fitness, FitnessIsa isa)
+{
+  const size_t N = population.dimension();
+  isa = std::min(isa, detectFitnessIsa());
+
+#ifdef BATCH_FITNESS_X86
+  /* Vectorised kernels read the one byte genes straight from the population buffer */
+  if (population.geneWidth() == 1 && isa == FitnessIsa::AVX2 && N <= BATCH_SIMD_MAX_DIMENSION)
+  {
+    for (size_t i = begin; i < end; i += 2)
+    {
+      // Odd last board is scored in both halves
+      double pair[2];
+      avx2Conflicts16(population.genes<uint8_t>(i), population.genes<uint8_t>(std::min(i + 1, end - 1)), N, pair);
+      fitness[i - begin] = pair[0];
+      if (i + 1 < end)
+        fitness[i + 1 - begin] = pair[1];
+    }
+    return;
+  }
+
+  if (population.geneWidth() == 1 && isa == FitnessIsa::SSE42 && N <= BATCH_SIMD_MAX_DIMENSION)
+  {
+    for (size_t i = begin; i < end; i ++)
+      fitness[i - begin] = sse42Conflicts16(population.genes<uint8_t>(i), N);
+    return;
+  }
+#endif
+
+  for (size_t i = begin; i < end; i ++)
+  {
+    population.visitGenes(i, [&] (const auto * genes)
+    {
+      fitness[i - begin] = histogramConflicts(genes, N);
+    });
+  }
+}
@@ -0,0 +1,35 @@
+/**
+ * @file batchFitness.hpp
+ * @author Ondrej
+ * @brief Scores whole blocks of a population at once, vectorised when the CPU supports it
+ *
+*/
+
+#pragma once
+
+#include "population.hpp"
+
+#include <cstddef>
+
+#define BATCH_SIMD_MAX_DIMENSION 16 // Vectorised kernels compare all queen pairs in one register, larger boards use the O(N) histogram
+
+/** Instruction set of the batch evaluator, a better one can run everything the previous ones can */
+enum class FitnessIsa
+{
+  Scalar,
+  SSE42,
+  AVX2
+};
+
+/** Returns the best instruction set supported by the CPU (detected once at startup) */
+FitnessIsa detectFitnessIsa(void);
+
+/** Returns name of the instruction set */
+const char * fitnessIsaName(FitnessIsa isa);
+
+/** Scores individuals [begin, end) of the population into fitness[0, end - begin). The score is the number of
+    attacking queen pairs, exactly the same as ConflictCounter::conflicts() for every instruction set.
+    isa is limited to what the CPU supports. Vectorised kernels score boards up to BATCH_SIMD_MAX_DIMENSION (AVX2 two boards
+    at once), larger boards are scored by the scalar histogram kernel straight from the narrow genes */
+void evaluateConflicts(const Population & population, size_t begin, size_t end, double * fitness,
+                       FitnessIsa isa = detectFitnessIsa());
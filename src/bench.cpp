@@ -0,0 +1,409 @@
+/**
+ * @file bench.cpp
+ * @author Ondrej
+ * @brief Benchmarks of the genetic algorithm kernels and of a whole generation step
+*/
+
+#include "geneticAlgorithm.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#define BENCH_SAMPLES 7 // Number of timed batches of every benchmark
+#define BENCH_BATCH_TIME 0.02 // Minimal duration of one batch in seconds, batch size is calibrated to reach it
+#define BENCH_SEED 42 // Benchmarks use a fixed seed so the runs are comparable
+#define BENCH_SOLVE_RUNS 3 // Number of seeds of the generations-to-solution benchmark
+
+namespace
+{
+  /** Result of one benchmark */
+  struct Measurement
+  {
+    std::string kernel;
+    std::string encoding;
+    size_t N;
+    size_t population;
+    size_t operations;
+    double mean;
+    double deviation;
+    double min;
+    double evaluationsPerSecond;
+    // Generations-to-solution benchmark only: average number of generations and fraction of solved runs
+    double generations = 0;
+    double solved = 0;
+  };
+
+  /** Options of the benchmark run */
+  struct Options
+  {
+    std::vector<size_t> sizes {8, 16, 32, 64, 100, 1000, 10000};
+    std::vector<size_t> populations {200, 500, 2000};
+    std::vector<std::string> encodings {"columns", "permutation"};
+    std::vector<size_t> solveSizes {8, 32, 100};
+    size_t solveRuns = BENCH_SOLVE_RUNS;
+    size_t samples = BENCH_SAMPLES;
+    double batchTime = BENCH_BATCH_TIME;
+    size_t threads = std::thread::hardware_concurrency();
+    bool json = true;
+  };
+
+  // Keeps the results of the kernels alive, so the compiler can not remove them
+  volatile double sink;
+
+  /** Times op (that does evaluations fitness evaluations) in samples batches, returns ns per operation */
+  Measurement measure(const std::string & kernel, const GeneticConfig & config, size_t N, size_t population,
+                      const Options & options, double evaluations, const std::function<void(void)> & op)
+  {
+    using Clock = std::chrono::steady_clock;
+
+    /* Batch grows until it takes at least batchTime, the calibration also warms up the caches */
+    size_t batch = 1;
+    while (true)
+    {
+      auto start = Clock::now();
+      for (size_t i = 0; i < batch; i ++)
+        op();
+      double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+      if (seconds >= options.batchTime)
+        break;
+      batch = seconds > 0 ? std::max(batch * 2, static_cast<size_t>(batch * options.batchTime / seconds * 1.2)) : batch * 2;
+    }
+
+    std::vector<double> samples;
+    for (size_t sample = 0; sample < options.samples; sample ++)
+    {
+      auto start = Clock::now();
+      for (size_t i = 0; i < batch; i ++)
+        op();
+      samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / batch);
+    }
+
+    double mean = 0;
+    for (double sample: samples)
+      mean += sample;
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double sample: samples)
+      variance += (sample - mean) * (sample - mean);
+    variance /= std::max<size_t>(samples.size() - 1, 1);
+
+    std::string encoding = config.encoding == Encoding::Columns ? "columns" : "permutation";
+    return {kernel, encoding, N, population, batch * options.samples, mean, std::sqrt(variance),
+            *std::min_element(samples.begin(), samples.end()), evaluations * 1e9 / mean};
+  }
+
+  /** Returns configuration of the algorithm with elites scaled to the population size */
+  GeneticConfig scaledConfig(GeneticConfig config, size_t population)
+  {
+    config.populationSize = population;
+    config.previousGenCount = std::max<size_t>(population * PREVIOUS_GEN_COUNT / POPULATION_SIZE, 1);
+    config.previousGenCrossoverCount = population * PREVIOUS_GEN_CROSSOVER_COUNT / POPULATION_SIZE;
+    config.validate();
+    return config;
+  }
+
+  /** Benchmarks kernels that only depend on the board size */
+  void benchIndividual(size_t N, const GeneticConfig & config, const Options & options, std::vector<Measurement> & results)
+  {
+    Genetic genetic(N, BENCH_SEED, 1, config);
+    Random random(BENCH_SEED);
+    Generation generation(0, MUTATION_RATE, CROSSOVER_RATE);
+
+    std::vector<size_t> individual1, individual2;
+    genetic.generateIndividual(individual1, random);
+    genetic.generateIndividual(individual2, random);
+    ConflictCounter counter1, counter2;
+    counter1.assign(individual1, config.fitnessCacheSize != 0);
+    counter2.assign(individual2, config.fitnessCacheSize != 0);
+
+    results.push_back(measure("getFitness", config, N, 0, options, 1, [&] ()
+    {
+      sink = generation.getFitness(individual1);
+    }));
+
+    std::vector<size_t> mutated = individual1;
+    ConflictCounter mutatedCounter = counter1;
+    results.push_back(measure("mutateIndividual", config, N, 0, options, 1, [&] ()
+    {
+      genetic.mutateIndividual(mutated, mutatedCounter, random);
+      sink = mutatedCounter.conflicts();
+    }));
+
+    std::pair<std::vector<size_t>, std::vector<size_t>> children;
+    std::pair<ConflictCounter, ConflictCounter> childrenCounters;
+    results.push_back(measure("crossoverIndividuals", config, N, 0, options, 2, [&] ()
+    {
+      genetic.crossoverIndividuals(individual1, counter1, individual2, counter2, children, childrenCounters, random);
+      sink = childrenCounters.first.conflicts() + childrenCounters.second.conflicts();
+    }));
+  }
+
+  /** Benchmarks kernels that depend on the population size and one whole generation step */
+  void benchPopulation(size_t N, size_t population, const GeneticConfig & baseConfig, const Options & options,
+                       std::vector<Measurement> & results)
+  {
+    GeneticConfig config = scaledConfig(baseConfig, population);
+    Genetic genetic(N, BENCH_SEED, options.threads, config);
+    // History only keeps the last population, otherwise large boards would run out of memory
+    genetic.setHistoryLimits(1, 0);
+    genetic.initialize();
+
+    Generation generation = genetic.getNthGeneration(0);
+    Random random(BENCH_SEED);
+
+    results.push_back(measure("getRandomTournament", config, N, population, options, 0, [&] ()
+    {
+      sink = generation.getRandomTournamentIndex(config.tournamentSize, random);
+    }));
+
+    /* Replacing an individual by itself invalidates the cached order, so every call selects again */
+    std::vector<size_t> first = generation.getIndividual(0);
+    double firstFitness = generation.getIndividualFitness(0);
+    results.push_back(measure("getNBest", config, N, population, options, 0, [&] ()
+    {
+      generation.replaceIndividual(0, first, firstFitness);
+      sink = generation.getNBestIndices(config.previousGenCount).front();
+    }));
+
+    /* Batch evaluator with every instruction set the CPU supports, the scalar one is the reference */
+    for (int isa = 0; isa <= static_cast<int>(detectFitnessIsa()); isa ++)
+    {
+      std::string kernel = std::string("evaluateGeneration/") + fitnessIsaName(static_cast<FitnessIsa>(isa));
+      results.push_back(measure(kernel, config, N, population, options, population, [&] ()
+      {
+        generation.evaluate(nullptr, static_cast<FitnessIsa>(isa));
+        sink = generation.getIndividualFitness(0);
+      }));
+    }
+
+    const size_t crossoverPairs = config.previousGenCrossoverCount / 2;
+    const size_t generationSize = 2 * population - config.previousGenCount - 2 * crossoverPairs;
+    results.push_back(measure("step", config, N, population, options, generationSize, [&] ()
+    {
+      sink = genetic.step();
+    }));
+  }
+
+  /** Runs the whole algorithm with several seeds and measures generations and time to the solution */
+  void benchSolve(size_t N, const GeneticConfig & config, const Options & options, std::vector<Measurement> & results)
+  {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> samples;
+    double generations = 0;
+    double solved = 0;
+    double evaluations = 0;
+    for (size_t run = 0; run < options.solveRuns; run ++)
+    {
+      Genetic genetic(N, Random::mix(BENCH_SEED + run), options.threads, config);
+      genetic.setHistoryLimits(1, 0);
+
+      auto start = Clock::now();
+      genetic.initialize();
+      while (genetic.hasNextGeneration())
+        genetic.step();
+      samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+
+      generations += genetic.getGenerationsCount();
+      solved += genetic.isFinished();
+      evaluations += genetic.getEvaluationsCount();
+    }
+
+    double mean = 0;
+    for (double sample: samples)
+      mean += sample;
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double sample: samples)
+      variance += (sample - mean) * (sample - mean);
+    variance /= std::max<size_t>(samples.size() - 1, 1);
+
+    std::string encoding = config.encoding == Encoding::Columns ? "columns" : "permutation";
+    Measurement result {"solve", encoding, N, config.populationSize, samples.size(), mean, std::sqrt(variance),
+                        *std::min_element(samples.begin(), samples.end()), evaluations / samples.size() * 1e9 / mean};
+    result.generations = generations / samples.size();
+    result.solved = solved / samples.size();
+    results.push_back(result);
+  }
+
+  /** Parses comma separated list of positive numbers */
+  std::vector<size_t> parseList(const std::string & option, const char * value)
+  {
+    std::vector<size_t> result;
+    std::istringstream parse(value);
+    std::string item;
+    while (std::getline(parse, item, ','))
+    {
+      std::istringstream parseItem(item);
+      size_t number;
+      if (!(parseItem >> number) || !parseItem.eof() || number == 0)
+        throw std::invalid_argument("Invalid value of " + option + ": " + value);
+      result.push_back(number);
+    }
+
+    if (result.empty())
+      throw std::invalid_argument("Missing value of " + option);
+
+    return result;
+  }
+
+  /** Parses positive number */
+  double parseNumber(const std::string & option, const char * value)
+  {
+    std::istringstream parse(value);
+    double number;
+    if (!(parse >> number) || !parse.eof() || number <= 0)
+      throw std::invalid_argument("Invalid value of " + option + ": " + value);
+
+    return number;
+  }
+
+  /** Prints usage of the benchmark */
+  void printUsage(const char * program)
+  {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --sizes N1,N2,...         board sizes (8,16,32,64,100,1000,10000 by default)\n"
+              << "  --populations P1,P2,...   population sizes (200,500,2000 by default)\n"
+              << "  --encodings E1,E2,...     columns and/or permutation (both by default)\n"
+              << "  --solve-sizes N1,N2,...   board sizes of the generations-to-solution benchmark (8,32,100 by default)\n"
+              << "  --solve-runs R            seeds of the generations-to-solution benchmark" << " (" << BENCH_SOLVE_RUNS << " by default)\n"
+              << "  --samples S               timed batches of every benchmark\n"
+              << "  --batch-time T            minimal duration of one batch in seconds\n"
+              << "  --threads T               worker threads of the generation step\n"
+              << "  --format json|human       output format (json by default)\n"
+              << "  --help                    prints this help" << std::endl;
+  }
+}
+
+/**
+ * @brief Runs the benchmarks and prints ns per operation and evaluations per second with their deviation
+ * - Kernels that depend only on N are measured once per board size, the others for every population size
+*/
+int main (int argc, char ** argv)
+{
+  Options options;
+
+  try
+  {
+    for (int i = 1; i < argc; i ++)
+    {
+      std::string option = argv[i];
+      if (option == "--help" || option == "-h")
+      {
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+      }
+
+      if (i + 1 >= argc)
+        throw std::invalid_argument("Missing value of " + option);
+      const char * value = argv[++ i];
+
+      if (option == "--sizes")
+        options.sizes = parseList(option, value);
+      else if (option == "--populations")
+        options.populations = parseList(option, value);
+      else if (option == "--encodings")
+      {
+        options.encodings.clear();
+        std::istringstream parse(value);
+        std::string encoding;
+        while (std::getline(parse, encoding, ','))
+        {
+          if (encoding != "columns" && encoding != "permutation")
+            throw std::invalid_argument("Unknown encoding: " + encoding);
+          options.encodings.push_back(encoding);
+        }
+      }
+      else if (option == "--solve-sizes")
+        options.solveSizes = parseList(option, value);
+      else if (option == "--solve-runs")
+        options.solveRuns = parseNumber(option, value);
+      else if (option == "--samples")
+        options.samples = std::max<size_t>(parseNumber(option, value), 2);
+      else if (option == "--batch-time")
+        options.batchTime = parseNumber(option, value);
+      else if (option == "--threads")
+        options.threads = parseNumber(option, value);
+      else if (option == "--format")
+      {
+        if (std::strcmp(value, "json") == 0)
+          options.json = true;
+        else if (std::strcmp(value, "human") == 0)
+          options.json = false;
+        else
+          throw std::invalid_argument(std::string("Unknown format: ") + value);
+      }
+      else
+        throw std::invalid_argument("Unknown option: " + option);
+    }
+
+    for (size_t population: options.populations)
+      scaledConfig(GeneticConfig(), population);
+  }
+  catch (const std::invalid_argument & error)
+  {
+    std::cerr << error.what() << std::endl;
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Measurement> results;
+  for (const std::string & encoding: options.encodings)
+  {
+    GeneticConfig config;
+    config.set("encoding", encoding);
+
+    for (size_t N: options.sizes)
+    {
+      benchIndividual(N, config, options, results);
+      for (size_t population: options.populations)
+        benchPopulation(N, population, config, options, results);
+    }
+
+    for (size_t N: options.solveSizes)
+      benchSolve(N, config, options, results);
+  }
+
+  if (!options.json)
+  {
+    std::cout << "kernel                     encoding         N population        ns/op    deviation     evaluations/s  generations\n";
+    for (const Measurement & result: results)
+    {
+      char line[256];
+      std::snprintf(line, sizeof(line), "%-26s %-12s %6zu %10zu %12.1f %12.1f %17.0f %12.1f", result.kernel.c_str(),
+                    result.encoding.c_str(), result.N, result.population, result.mean, result.deviation,
+                    result.evaluationsPerSecond, result.generations);
+      std::cout << line << "\n";
+    }
+    std::cout << std::flush;
+    return EXIT_SUCCESS;
+  }
+
+  /* One JSON document, population is 0 for the kernels that do not depend on it */
+  std::cout << "{\"threads\":" << options.threads << ",\"samples\":" << options.samples << ",\"results\":[";
+  for (size_t i = 0; i < results.size(); i ++)
+  {
+    const Measurement & result = results[i];
+    std::cout << (i != 0 ? "," : "") << "\n  {\"kernel\":\"" << result.kernel << "\",\"encoding\":\"" << result.encoding
+              << "\",\"n\":" << result.N
+              << ",\"population\":" << result.population << ",\"operations\":" << result.operations
+              << ",\"ns_per_op\":" << result.mean << ",\"ns_per_op_stddev\":" << result.deviation
+              << ",\"ns_per_op_min\":" << result.min << ",\"evaluations_per_second\":" << result.evaluationsPerSecond;
+    if (result.kernel == "solve")
+      std::cout << ",\"generations\":" << result.generations << ",\"solved\":" << result.solved;
+    std::cout << "}";
+  }
+  std::cout << "\n]}" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -12,7 +12,11 @@
 #include <random>
 #include <thread>
 #include <sstream>
+#include <iomanip>
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 
 /** Processes all user input */
 void BoardVisualisation::processInput(sf::Event & event)
@@ -25,14 +29,22 @@ void BoardVisualisation::processInput(sf::Event & event)
   else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Escape))
     m_window.close();
 
-  /** Pause animation if SPACE is pressed */
+  /** Pause animation and the solver if SPACE is pressed, paused solver sleeps and the frame rate drops */
   else if (event.type == sf::Event::KeyReleased && event.key.code == sf::Keyboard::Space)
   {
     m_paused = !m_paused;
     if (m_paused)
+    {
+      m_islands.pause();
       m_window.setTitle(m_screenTitle + " -  (PAUSED)");
+      m_window.setFramerateLimit(PAUSED_FRAMERATE);
+    }
     else
+    {
+      m_islands.resume();
       m_window.setTitle(m_screenTitle);
+      m_window.setFramerateLimit(360);
+    }
   }
 
   /* Change speed (Faster) */
@@ -47,11 +59,90 @@ void BoardVisualisation::processInput(sf::Event & event)
     m_stepDelay = std::min(0.75f, m_stepDelay * 1.5f);
   }
 
-  /* If R pressed, reset animation */
-  else if (sf::Keyboard::isKeyPressed(sf::Keyboard::R))
+  /* Seek by one generation (Left/Right) or by SEEK_STEP_LARGE generations (Down/Up) */
+  else if (event.type == sf::Event::KeyPressed && (event.key.code == sf::Keyboard::Left || event.key.code == sf::Keyboard::Right
+                                                   || event.key.code == sf::Keyboard::Down || event.key.code == sf::Keyboard::Up))
+  {
+    size_t step = event.key.code == sf::Keyboard::Left || event.key.code == sf::Keyboard::Right ? 1 : SEEK_STEP_LARGE;
+    if (event.key.code == sf::Keyboard::Left || event.key.code == sf::Keyboard::Down)
+      this -> seek(m_visualisationIndex - std::min(step, m_visualisationIndex));
+    else
+      this -> seek(m_visualisationIndex + step);
+  }
+
+  /* Jump to the first or to the last generation */
+  else if (event.type == sf::Event::KeyPressed && (event.key.code == sf::Keyboard::Home || event.key.code == sf::Keyboard::End))
+  {
+    this -> seek(event.key.code == sf::Keyboard::Home ? 0 : SIZE_MAX);
+  }
+
+  /* Clicking or dragging over the scrub bar seeks to the generation under the mouse */
+  else if ((event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left
+            && m_scrubBar.contains(event.mouseButton.x, event.mouseButton.y))
+           || (event.type == sf::Event::MouseMoved && m_scrubbing))
+  {
+    m_scrubbing = true;
+    float x = event.type == sf::Event::MouseMoved ? event.mouseMove.x : event.mouseButton.x;
+    float ratio = std::clamp((x - m_scrubBar.left) / m_scrubBar.width, 0.0f, 1.0f);
+    size_t count = this -> getGenerationsCount();
+    if (count != 0)
+      this -> seek(static_cast<size_t>(ratio * (count - 1) + 0.5f));
+  }
+
+  else if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+  {
+    m_scrubbing = false;
+  }
+
+  /* Mouse wheel zooms the board around the mouse, dragging with the right button moves it, 0 shows the whole board */
+  else if (event.type == sf::Event::MouseWheelScrolled && m_boardArea.contains(event.mouseWheelScroll.x, event.mouseWheelScroll.y))
+  {
+    this -> zoom(std::pow(ZOOM_STEP, event.mouseWheelScroll.delta), sf::Vector2f(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+  }
+
+  else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right
+           && m_boardArea.contains(event.mouseButton.x, event.mouseButton.y))
+  {
+    m_panning = true;
+    m_panStart = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+  }
+
+  else if (event.type == sf::Event::MouseMoved && m_panning)
+  {
+    sf::Vector2i position(event.mouseMove.x, event.mouseMove.y);
+    this -> pan(sf::Vector2f(position - m_panStart));
+    m_panStart = position;
+  }
+
+  else if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Right)
+  {
+    m_panning = false;
+  }
+
+  else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Num0)
+  {
+    m_zoom = 1.0f;
+  }
+
+  /* If I pressed, show next island (after the last island the global best is shown) */
+  else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::I)
+  {
+    m_shownIsland = (m_shownIsland + 1) % (m_islands.getIslandCount() + 1);
+  }
+
+  /* If P pressed, show or hide the phase profile */
+  else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+  {
+    m_showProfile = !m_showProfile;
+  }
+
+  /* If R pressed, restart the solver with a new seed (recorded run is only rewound) */
+  else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R)
   {
+    if (!m_replay)
+      this -> restartSolver();
     /* If visualisation already started, then reset it */
-    if (m_startVisualisation)
+    else if (m_startVisualisation)
       m_visualisationIndex = 0;
   }
 }
@@ -59,8 +150,8 @@ void BoardVisualisation::processInput(sf::Event & event)
 /** The main loop */
 void BoardVisualisation::mainLoop(void)
 {
-  /* Calculate the N-Queens problem */
-  std::thread thr(std::bind(&Genetic::run, &m_genetic));
+  /* Calculate the N-Queens problem (recorded run is only read) */
+  this -> startSolver();
   m_startTime = std::chrono::high_resolution_clock::now();
 
   sf::Event event;
@@ -82,7 +173,7 @@ void BoardVisualisation::mainLoop(void)
       /* Update step - due to multi threading there needs to be these conditions, explanation:
          we check whether we can take generation that has already been preprocessed in the thread, so it would be
          safe to work with or if have have finished all the generations, then we can taky any completed generation */
-      if ((m_visualisationIndex + 1) < m_genetic.getGenerationsCount())
+      if ((m_visualisationIndex + 1) < this -> getGenerationsCount())
       {
 
         /* Initialize the start of the visualisation */
@@ -96,6 +187,11 @@ void BoardVisualisation::mainLoop(void)
       currentStepTime = 0.0f;
     }
 
+    /* Count shrinks when an island that was behind claims an earlier solution, the shown generation has to exist */
+    size_t count = this -> getGenerationsCount();
+    if (count != 0 && m_visualisationIndex >= count)
+      m_visualisationIndex = count - 1;
+
     m_window.clear(sf::Color(39,36,33,255));
 
     showBoard();
@@ -103,7 +199,48 @@ void BoardVisualisation::mainLoop(void)
     m_window.display();
 
   }
-  thr.join();
+
+  // Running solver stops at its next generation
+  this -> stopSolver();
+}
+
+/** Starts the solver thread (not in the replay mode) */
+void BoardVisualisation::startSolver(void)
+{
+  if (!m_replay)
+    m_solver = std::thread(std::bind(&IslandModel::run, &m_islands));
+}
+
+/** Asks the solver to stop and waits for it, it stops within one generation (also if it is paused) */
+void BoardVisualisation::stopSolver(void)
+{
+  m_islands.requestStop();
+  if (m_solver.joinable())
+    m_solver.join();
+}
+
+/** Stops the solver and starts a new run with a new seed */
+void BoardVisualisation::restartSolver(void)
+{
+  /* Islands (and the summaries the visualisation reads) are replaced only after the solver thread finished,
+     nothing keeps references into them between frames */
+  this -> stopSolver();
+  m_islands.restart(Random::randomSeed());
+
+  // Everything cached belongs to the previous run
+  m_visualisationIndex = 0;
+  m_startVisualisation = false;
+  m_series.clear();
+  m_graphSeries = SIZE_MAX;
+  std::get<0>(m_queensKey) = SIZE_MAX;
+  std::get<0>(m_hudKey) = SIZE_MAX;
+
+  m_paused = false;
+  m_window.setTitle(m_screenTitle);
+  m_window.setFramerateLimit(360);
+  m_startTime = std::chrono::high_resolution_clock::now();
+
+  this -> startSolver();
 }
 
 /** Loads texture from cache/file */
@@ -121,85 +258,337 @@ std::shared_ptr<sf::Texture> BoardVisualisation::loadTexture(std::string filenam
 }
 
 
-/** Displays the whole board */
-void BoardVisualisation::showBoard(void)
+/** Returns island that is displayed in the current generation */
+size_t BoardVisualisation::getDisplayedIsland(void)
 {
-  unsigned int smallerWinSize = std::min(m_window.getSize().x, m_window.getSize().y);
-  float squareSize = (smallerWinSize - 75) / m_dimension;
-  float queenSize = 0.5 ;
+  if (m_shownIsland < m_islands.getIslandCount())
+    return m_shownIsland;
+
+  return m_islands.getBestIsland(m_visualisationIndex);
+}
 
-  sf::VertexArray squares(sf::Quads, m_dimension * m_dimension * 4);
-  size_t vertexIndex = 0;
+/** Returns number of generations that can be displayed (computed so far or recorded) */
+size_t BoardVisualisation::getGenerationsCount(void)
+{
+  if (m_replay)
+    return m_replay -> size();
 
-  float X = LEFT_PADDING;
-  float Y = TOP_PADDING;
+  return m_islands.getGenerationsCount();
+}
 
-  for (size_t i = 0; i < m_dimension; i ++)
+/** Returns stats and the best individual of the displayed generation, nullptr if there is none yet */
+const GenerationSummary * BoardVisualisation::getDisplayedSummary(void)
+{
+  /* Only the record of the displayed generation is read from the mapped log */
+  if (m_replay)
   {
-    for (size_t j = 0; j < m_dimension; j ++)
+    if (m_replay -> size() == 0)
+      return nullptr;
+
+    size_t index = std::min(m_visualisationIndex, m_replay -> size() - 1);
+    if (index != m_replayIndex)
     {
-      sf::Color color;
-      /* Decide colour based on square positon */
-      if ((i % 2 != 0 && j % 2 != 0)|| (i % 2 == 0 && j % 2 == 0) )
-        color = sf::Color(238,238,210,255);
-      else
-        color = sf::Color(118,150,86,255);
-
-      squares[vertexIndex].color = color;
-      squares[vertexIndex].position = sf::Vector2f(X, Y);
-      vertexIndex ++;
-
-      squares[vertexIndex].color = color;
-      squares[vertexIndex].position = sf::Vector2f(X + squareSize, Y);
-      vertexIndex ++;
-
-      squares[vertexIndex].position = sf::Vector2f(X + squareSize, Y + squareSize);
-      squares[vertexIndex].color = color;
-      vertexIndex ++;
-
-      squares[vertexIndex].color = color;
-      squares[vertexIndex].position = sf::Vector2f(X, Y + squareSize);
-      vertexIndex ++;
-
-      X += squareSize;
+      m_replaySummary = m_replay -> getSummary(index);
+      m_replayIndex = index;
     }
+    return &m_replaySummary;
+  }
+
+  /* Islands can be one generation apart, show the last generation of the island if it is behind */
+  Genetic & genetic = m_islands.getIsland(this -> getDisplayedIsland());
+  size_t generationsCount = genetic.getGenerationsCount();
+  if (generationsCount == 0)
+    return nullptr;
+
+  return &genetic.getNthSummary(std::min(m_visualisationIndex, generationsCount - 1));
+}
+
+/** Jumps to the generation (clamped to the generations that can be displayed) */
+void BoardVisualisation::seek(size_t index)
+{
+  size_t count = this -> getGenerationsCount();
+  if (count == 0)
+    return;
+
+  m_visualisationIndex = std::min(index, count - 1);
+  m_startVisualisation = true;
+}
+
+/** Zooms the board by the factor, the square under the pixel stays in place */
+void BoardVisualisation::zoom(float factor, sf::Vector2f pixel)
+{
+  float maxZoom = std::max(1.0f, m_dimension / MIN_VISIBLE_SQUARES);
+  float zoom = std::clamp(m_zoom * factor, 1.0f, maxZoom);
+
+  /* Square under the pixel before the zoom is moved back under it */
+  sf::Vector2f offset = pixel - sf::Vector2f(m_boardArea.left + m_boardArea.width / 2, m_boardArea.top + m_boardArea.height / 2);
+  float squaresPerPixel = m_dimension / (m_boardArea.width * m_zoom);
+  sf::Vector2f square = m_viewCenter + offset * squaresPerPixel;
+  m_zoom = zoom;
+  m_viewCenter = square - offset * (m_dimension / (m_boardArea.width * m_zoom));
+}
 
-    Y += squareSize;
-    X = LEFT_PADDING;
+/** Moves the board by the pixel distance */
+void BoardVisualisation::pan(sf::Vector2f pixels)
+{
+  m_viewCenter -= pixels * (m_dimension / (m_boardArea.width * m_zoom));
+}
 
+/** Creates the retained board geometry */
+void BoardVisualisation::buildBoard(void)
+{
+  /* Checkerboard is a 2x2 texture repeated over the board, square (x, y) is light if x and y have the same parity */
+  sf::Image checker;
+  checker.create(2, 2, sf::Color(238,238,210,255));
+  checker.setPixel(1, 0, sf::Color(118,150,86,255));
+  checker.setPixel(0, 1, sf::Color(118,150,86,255));
+  m_boardTexture.loadFromImage(checker);
+  m_boardTexture.setRepeated(true);
+
+  sf::Image flat;
+  flat.create(1, 1, sf::Color(178,194,148,255));
+  m_boardFlatTexture.loadFromImage(flat);
+  m_boardFlatTexture.setRepeated(true);
+
+  float N = m_dimension;
+  m_boardVertices[0] = sf::Vertex(sf::Vector2f(0, 0), sf::Vector2f(0, 0));
+  m_boardVertices[1] = sf::Vertex(sf::Vector2f(N, 0), sf::Vector2f(N, 0));
+  m_boardVertices[2] = sf::Vertex(sf::Vector2f(N, N), sf::Vector2f(N, N));
+  m_boardVertices[3] = sf::Vertex(sf::Vector2f(0, N), sf::Vector2f(0, N));
+
+  if (sf::VertexBuffer::isAvailable())
+  {
+    m_boardBuffer.create(4);
+    m_boardBuffer.update(m_boardVertices);
   }
 
-  m_window.draw(squares);
+  m_viewCenter = sf::Vector2f(N / 2, N / 2);
+  m_boardBuilt = true;
+}
+
+/** Returns view of the visible part of the board placed into m_boardArea */
+sf::View BoardVisualisation::boardView(void)
+{
+  /* Visible part stays inside the board */
+  float visible = m_dimension / m_zoom;
+  m_viewCenter.x = std::clamp(m_viewCenter.x, visible / 2, m_dimension - visible / 2);
+  m_viewCenter.y = std::clamp(m_viewCenter.y, visible / 2, m_dimension - visible / 2);
+
+  sf::View view;
+  view.setCenter(m_viewCenter);
+  view.setSize(visible, visible);
+
+  sf::Vector2u windowSize = m_window.getSize();
+  view.setViewport(sf::FloatRect(m_boardArea.left / windowSize.x, m_boardArea.top / windowSize.y,
+                                 m_boardArea.width / windowSize.x, m_boardArea.height / windowSize.y));
+  return view;
+}
 
+/** Rebuilds the batched queens of the generation if the generation or the visible part of the board changed */
+void BoardVisualisation::updateQueens(const GenerationSummary & generation, size_t island)
+{
+  float visible = m_dimension / m_zoom;
+  float left = m_viewCenter.x - visible / 2;
+  float top = m_viewCenter.y - visible / 2;
 
-  /* Displays the queens */
+  /* Queens are grouped into cells of cellSize x cellSize squares, so a cell is at least LOD_MIN_SQUARE_PIXELS wide */
+  float squarePixels = m_boardArea.width / visible;
+  size_t cellSize = squarePixels >= LOD_MIN_SQUARE_PIXELS ? 1 : static_cast<size_t>(std::ceil(LOD_MIN_SQUARE_PIXELS / squarePixels));
 
-  // If we can start the visualisation
-  if (!m_startVisualisation)
+  auto key = std::make_tuple(island, generation.index, left, top, visible, cellSize);
+  if (key == m_queensKey)
     return;
+  m_queensKey = key;
+  m_queens.clear();
 
-  auto texture = this -> loadTexture("assets/queen_white");
-  // If texture could not be loaded
-  if (!m_startVisualisation)
+  const std::vector<size_t> & queens = generation.bestIndividual;
+  size_t first = static_cast<size_t>(std::max(0.0f, std::floor(left)));
+  size_t last = std::min(queens.size(), static_cast<size_t>(std::ceil(left + visible)));
+  size_t topRow = static_cast<size_t>(std::max(0.0f, std::floor(top)));
+  size_t bottomRow = std::min(m_dimension, static_cast<size_t>(std::ceil(top + visible)));
+
+  /* Every visible queen is one quad of the batch, texture coordinates cover the whole queen texture */
+  if (cellSize == 1)
+  {
+    auto texture = this -> loadTexture("assets/queen_white");
+    sf::Vector2f size = texture ? sf::Vector2f(texture -> getSize()) : sf::Vector2f(1, 1);
+    m_queensTextured = true;
+    for (size_t i = first; i < last; i ++)
+    {
+      if (queens[i] < topRow || queens[i] >= bottomRow)
+        continue;
+
+      float x = i;
+      float y = queens[i];
+      m_queens.append(sf::Vertex(sf::Vector2f(x, y), sf::Vector2f(0, 0)));
+      m_queens.append(sf::Vertex(sf::Vector2f(x + 1, y), sf::Vector2f(size.x, 0)));
+      m_queens.append(sf::Vertex(sf::Vector2f(x + 1, y + 1), sf::Vector2f(size.x, size.y)));
+      m_queens.append(sf::Vertex(sf::Vector2f(x, y + 1), sf::Vector2f(0, size.y)));
+    }
     return;
+  }
+
+  /* Density cells, a cell holds at most cellSize queens (one per row), the more queens the more opaque it is */
+  size_t firstCell = first / cellSize;
+  size_t topCell = topRow / cellSize;
+  size_t cellsX = (last + cellSize - 1) / cellSize - firstCell;
+  size_t cellsY = (bottomRow + cellSize - 1) / cellSize - topCell;
+  m_densityCells.assign(cellsX * cellsY, 0);
+  m_queensTextured = false;
+
+  for (size_t i = first; i < last; i ++)
+  {
+    if (queens[i] < topRow || queens[i] >= bottomRow)
+      continue;
+
+    m_densityCells[(queens[i] / cellSize - topCell) * cellsX + i / cellSize - firstCell] ++;
+  }
+
+  for (size_t y = 0; y < cellsY; y ++)
+  {
+    for (size_t x = 0; x < cellsX; x ++)
+    {
+      uint32_t count = m_densityCells[y * cellsX + x];
+      if (count == 0)
+        continue;
+
+      sf::Color color(255, 255, 255, static_cast<sf::Uint8>(std::min<size_t>(255, 96 + 159 * count / cellSize)));
+      float X = (firstCell + x) * cellSize;
+      float Y = (topCell + y) * cellSize;
+      m_queens.append(sf::Vertex(sf::Vector2f(X, Y), color));
+      m_queens.append(sf::Vertex(sf::Vector2f(X + cellSize, Y), color));
+      m_queens.append(sf::Vertex(sf::Vector2f(X + cellSize, Y + cellSize), color));
+      m_queens.append(sf::Vertex(sf::Vector2f(X, Y + cellSize), color));
+    }
+  }
+}
 
-  texture -> setSmooth(true);
-  sf::Sprite sprite;
-  sprite = sf::Sprite(*texture);
-  sprite.setScale(squareSize / texture -> getSize().x, squareSize / texture -> getSize().y);
+/** Adds the generations computed (or read from the log) since the last frame to the fitness series */
+void BoardVisualisation::feedGraph(void)
+{
+  size_t islands = m_islands.getIslandCount();
+  if (m_series.empty())
+    m_series.resize(islands > 1 ? islands + 1 : 1);
 
-  Generation gen = m_genetic.getNthGeneration(m_visualisationIndex);
-  std::vector<std::vector<size_t>> nbest = gen.getNBest(1);
-  if (nbest.size() == 0)
+  /* Only the fixed part of the records is read */
+  if (m_replay)
+  {
+    FitnessSeries & series = m_series[0];
+    size_t end = std::min(m_replay -> size(), series.size() + GRAPH_FEED_LIMIT);
+    for (size_t i = series.size(); i < end; i ++)
+    {
+      const RunLogRecord & record = m_replay -> getRecord(i);
+      series.append(record.bestFitness, record.averageFitness);
+    }
     return;
+  }
+
+  /* Published summaries are read lock-free, every series continues where it stopped */
+  size_t common = SIZE_MAX;
+  for (size_t island = 0; island < islands; island ++)
+  {
+    Genetic & genetic = m_islands.getIsland(island);
+    FitnessSeries & series = m_series[island];
+    size_t end = std::min(genetic.getGenerationsCount(), series.size() + GRAPH_FEED_LIMIT);
+    for (size_t i = series.size(); i < end; i ++)
+    {
+      const GenerationSummary & summary = genetic.getNthSummary(i);
+      series.append(summary.bestFitness, summary.averageFitness);
+    }
+    common = std::min(common, series.size());
+  }
+
+  // Best of the islands, for the generations every island has
+  if (islands > 1)
+  {
+    FitnessSeries & series = m_series[islands];
+    for (size_t i = series.size(); i < common; i ++)
+    {
+      double best = DBL_MAX;
+      double average = 0;
+      for (size_t island = 0; island < islands; island ++)
+      {
+        const GenerationSummary & summary = m_islands.getIsland(island).getNthSummary(i);
+        best = std::min(best, summary.bestFitness);
+        average += summary.averageFitness / islands;
+      }
+      series.append(best, average);
+    }
+  }
+}
+
+/** Returns index of the series of the displayed island in m_series */
+size_t BoardVisualisation::getGraphSeries(void)
+{
+  return std::min(m_shownIsland, m_series.size() - 1);
+}
+
+/** Updates the graph vertices from the series */
+void BoardVisualisation::updateGraph(void)
+{
+  size_t index = this -> getGraphSeries();
+  const FitnessSeries & series = m_series[index];
+  if (index != m_graphSeries || series.merges() != m_graphMerges)
+  {
+    m_graphBest.clear();
+    m_graphAverage.clear();
+    m_graphSeries = index;
+    m_graphMerges = series.merges();
+  }
 
-  std::vector<size_t> queens = nbest[0];
+  /* Every bucket is two vertices (its maximum and minimum), x is the bucket index, y the fitness */
+  const std::vector<FitnessBucket> & buckets = series.buckets();
+  size_t first = m_graphBest.getVertexCount() / 2;
+  if (first != 0)
+    first --;
 
-  for (size_t i = 0; i < queens.size(); i ++)
+  m_graphBest.resize(2 * first);
+  m_graphAverage.resize(2 * first);
+  for (size_t i = first; i < buckets.size(); i ++)
   {
-    sprite.setPosition(LEFT_PADDING + i * squareSize, TOP_PADDING + queens[i] * squareSize);
-    m_window.draw(sprite);
+    m_graphBest.append(sf::Vertex(sf::Vector2f(i, buckets[i].maxBest), sf::Color(238,238,210,255)));
+    m_graphBest.append(sf::Vertex(sf::Vector2f(i + 0.5f, buckets[i].minBest), sf::Color(238,238,210,255)));
+    m_graphAverage.append(sf::Vertex(sf::Vector2f(i, buckets[i].maxAverage), sf::Color(118,150,86,255)));
+    m_graphAverage.append(sf::Vertex(sf::Vector2f(i + 0.5f, buckets[i].minAverage), sf::Color(118,150,86,255)));
   }
+}
+
+/** Draws the fitness graph and the marker of the displayed generation */
+void BoardVisualisation::drawGraph(float left)
+{
+  this -> feedGraph();
+  this -> updateGraph();
+
+  sf::RectangleShape frame(sf::Vector2f(GRAPH_SIZE_X, GRAPH_SIZE_Y));
+  frame.setPosition(left, TOP_PADDING_GRAPH);
+  frame.setFillColor(sf::Color(49,46,43,255));
+  m_window.draw(frame);
+
+  const FitnessSeries & series = m_series[m_graphSeries];
+  if (series.size() == 0)
+    return;
+
+  /* Vertices stay in the series units, the transform fits the buckets and the fitness range into the plot */
+  float plotWidth = GRAPH_SIZE_X - 2 * LEFT_PADDING_GRAPH;
+  float plotHeight = GRAPH_SIZE_Y - 2 * LEFT_PADDING_GRAPH;
+  double maxFitness = std::max(1.0, series.maxFitness());
+
+  sf::Transform transform;
+  transform.translate(left + LEFT_PADDING_GRAPH, TOP_PADDING_GRAPH + LEFT_PADDING_GRAPH + plotHeight);
+  transform.scale(plotWidth / series.capacity(), -plotHeight / maxFitness);
+
+  m_window.draw(m_graphAverage, sf::RenderStates(transform));
+  m_window.draw(m_graphBest, sf::RenderStates(transform));
+
+  float x = static_cast<float>(std::min(m_visualisationIndex, series.size() - 1)) / series.bucketWidth();
+  sf::Vertex marker[2] = {sf::Vertex(sf::Vector2f(x, 0), sf::Color::White), sf::Vertex(sf::Vector2f(x, maxFitness), sf::Color::White)};
+  m_window.draw(marker, 2, sf::Lines, sf::RenderStates(transform));
+}
+
+/** Draws the stats of the generation */
+void BoardVisualisation::renderHud(sf::RenderTarget & target, const GenerationSummary & gen, size_t island, float boardSize)
+{
+  Genetic & genetic = m_islands.getIsland(island);
 
   /* Displays text*/
   sf::Text text;
@@ -209,8 +598,8 @@ void BoardVisualisation::showBoard(void)
 
   // Generation
   text.setString("Generation: " + std::to_string(m_visualisationIndex));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension / 2 - 75, TOP_PADDING_TEXT);
-  m_window.draw(text);
+  text.setPosition(LEFT_PADDING + boardSize / 2 - 75, TOP_PADDING_TEXT);
+  target.draw(text);
 
   text.setCharacterSize(25);
 
@@ -227,34 +616,201 @@ void BoardVisualisation::showBoard(void)
   std::ostringstream oss;
   oss << minutes.count() << ":" << seconds.count() << ":" << milliseconds.count();
   text.setString("Elapsed Time: " + oss.str());
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 50);
-  m_window.draw(text);
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 50);
+  target.draw(text);
   */
 
-  text.setString("Max Generations count: " + std::to_string(GENERATIONS));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 100);
-  m_window.draw(text);
+  /* Parameters of a replayed run are not recorded, its length and population (if recorded) are shown instead */
+  if (m_replay)
+    text.setString("Recorded Generations: " + std::to_string(m_replay -> size()));
+  else
+    text.setString("Max Generations count: " + std::to_string(genetic.getConfig().generations));
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 100);
+  target.draw(text);
+
+  if (!m_replay || m_replay -> hasPopulations())
+  {
+    size_t populationSize = m_replay ? m_replay -> getRecord(m_replayIndex).populationSize : genetic.getConfig().populationSize;
+    text.setString("Population Size: " + std::to_string(populationSize));
+    text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 150);
+    target.draw(text);
+  }
+
+  text.setString("Mutation Rate: " + std::to_string(gen.mutationRate));
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 200);
+  target.draw(text);
+
+  text.setString("Crossover Rate: " + std::to_string(gen.crossoverRate));
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 250);
+  target.draw(text);
 
-  text.setString("Population Size: " + std::to_string(POPULATION_SIZE));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 150);
-  m_window.draw(text);
 
-  text.setString("Mutation Rate: " + std::to_string(gen.getMutationRate()));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 200);
-  m_window.draw(text);
+  text.setString("Average Fitness: " + std::to_string(gen.averageFitness));
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 300);
+  target.draw(text);
+
+  text.setString("Best Fitness: " + std::to_string(gen.bestFitness));
+  text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 350);
+  target.draw(text);
+
+  if (m_islands.getIslandCount() > 1)
+  {
+    if (m_shownIsland < m_islands.getIslandCount())
+      text.setString("Island: " + std::to_string(island + 1) + " / " + std::to_string(m_islands.getIslandCount()));
+    else
+      text.setString("Island: best (" + std::to_string(island + 1) + " / " + std::to_string(m_islands.getIslandCount()) + ")");
+    text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_TEXT + 400);
+    target.draw(text);
+  }
+
+  // Legend of the fitness graph
+  if (!m_series.empty())
+  {
+    text.setCharacterSize(18);
+    text.setString("Fitness - best (light), average (green), max " + std::to_string(std::max(1.0, m_series[this -> getGraphSeries()].maxFitness())));
+    text.setPosition(LEFT_PADDING + boardSize + 100, TOP_PADDING_GRAPH + GRAPH_SIZE_Y + 5);
+    target.draw(text);
+  }
+
+  if (m_showProfile)
+    this -> renderProfile(target, gen, island);
+}
+
+/** Draws time of the phases of the generation over the board, one line and one bar (share of the step) per phase */
+void BoardVisualisation::renderProfile(sf::RenderTarget & target, const GenerationSummary & gen, size_t island)
+{
+  Genetic & genetic = m_islands.getIsland(island);
+
+  sf::RectangleShape panel(sf::Vector2f(PROFILE_PANEL_WIDTH, (PHASE_COUNT + 2) * PROFILE_LINE_HEIGHT));
+  panel.setPosition(LEFT_PADDING + 10, TOP_PADDING + 10);
+  panel.setFillColor(sf::Color(0, 0, 0, 190));
+  target.draw(panel);
+
+  sf::Text text;
+  text.setFont(m_font);
+  text.setCharacterSize(16);
+  text.setFillColor(sf::Color::White);
+  text.setPosition(LEFT_PADDING + 20, TOP_PADDING + 15);
+
+  /* Recorded runs have no profile, nor do runs of a build without profiling */
+  if (m_replay || !NQUEENS_PROFILE || gen.index >= genetic.getProfilesCount())
+  {
+    text.setString("No phase profile of this generation");
+    target.draw(text);
+    return;
+  }
+
+  PhaseProfile profile = genetic.getProfile(gen.index);
+  double total = std::max<uint64_t>(profile.time(Phase::Total), 1);
+  text.setString("Phases of generation " + std::to_string(gen.index) + " (ms, calls)");
+  target.draw(text);
+
+  sf::RectangleShape bar;
+  bar.setFillColor(sf::Color(118,150,86,255));
+  for (size_t i = 0; i < PHASE_COUNT; i ++)
+  {
+    Phase phase = static_cast<Phase>(i);
+    float top = TOP_PADDING + 15 + (i + 1) * PROFILE_LINE_HEIGHT;
+
+    // Time of the phases on the workers is summed over them, so the bar is capped at the width of the panel
+    float share = std::min(1.0, profile.time(phase) / total);
+    bar.setSize(sf::Vector2f((PROFILE_PANEL_WIDTH - 20) * share, PROFILE_LINE_HEIGHT - 6));
+    bar.setPosition(LEFT_PADDING + 20, top + 3);
+    target.draw(bar);
+
+    std::ostringstream line;
+    line << phaseName(phase) << ": " << std::fixed << std::setprecision(3) << profile.time(phase) / 1e6 << " ms, " << profile.count(phase);
+    text.setString(line.str());
+    text.setPosition(LEFT_PADDING + 20, top);
+    target.draw(text);
+  }
+}
+
+/** Displays the whole board */
+void BoardVisualisation::showBoard(void)
+{
+  unsigned int smallerWinSize = std::min(m_window.getSize().x, m_window.getSize().y);
+  float squareSize = (smallerWinSize - 75) / m_dimension;
+  // Boards larger than the window have squares smaller than a pixel (queens are shown as density cells then)
+  if (squareSize < 1)
+    squareSize = (smallerWinSize - 75.0f) / m_dimension;
+
+  /* Board and queens are drawn in square units through the board view, text in pixels through the window view */
+  sf::Vector2u windowSize = m_window.getSize();
+  sf::View windowView(sf::FloatRect(0, 0, windowSize.x, windowSize.y));
+  float boardSize = squareSize * m_dimension;
+  m_boardArea = sf::FloatRect(LEFT_PADDING, TOP_PADDING, boardSize, boardSize);
+
+  if (!m_boardBuilt)
+    this -> buildBoard();
+
+  sf::View view = this -> boardView();
+  m_window.setView(view);
+
+  // Squares too small to be told apart are drawn in their average colour
+  bool detailed = boardSize * m_zoom / m_dimension >= LOD_MIN_SQUARE_PIXELS;
+  sf::RenderStates boardStates(detailed ? &m_boardTexture : &m_boardFlatTexture);
+  if (sf::VertexBuffer::isAvailable())
+    m_window.draw(m_boardBuffer, boardStates);
+  else
+    m_window.draw(m_boardVertices, 4, sf::Quads, boardStates);
+
+  /* Displays the queens */
+  size_t island = this -> getDisplayedIsland();
+  const GenerationSummary * displayed = m_startVisualisation ? this -> getDisplayedSummary() : nullptr;
+  if (displayed == nullptr || displayed -> bestIndividual.size() == 0)
+  {
+    m_window.setView(windowView);
+    return;
+  }
+
+  const GenerationSummary & gen = *displayed;
+
+  auto texture = this -> loadTexture("assets/queen_white");
+  this -> updateQueens(gen, island);
+  if (m_queensTextured && texture)
+  {
+    texture -> setSmooth(true);
+    m_window.draw(m_queens, sf::RenderStates(texture.get()));
+  }
+  else if (!m_queensTextured)
+    m_window.draw(m_queens);
+
+  m_window.setView(windowView);
+
+  /* Stats are rendered into the cached texture only when the displayed generation or the window size changes.
+     Max of the graph legend grows while the series is filled, also when the displayed generation stays */
+  double graphMax = m_series.empty() ? 0 : m_series[this -> getGraphSeries()].maxFitness();
+  auto hudKey = std::make_tuple(m_visualisationIndex, gen.index, island, m_shownIsland, windowSize.x, windowSize.y, m_showProfile,
+                                graphMax);
+  if (hudKey != m_hudKey)
+  {
+    if (m_hud.getSize().x != windowSize.x || m_hud.getSize().y != windowSize.y)
+      m_hud.create(windowSize.x, windowSize.y);
+
+    m_hud.clear(sf::Color::Transparent);
+    this -> renderHud(m_hud, gen, island, boardSize);
+    m_hud.display();
+    m_hudKey = hudKey;
+  }
+
+  m_window.draw(sf::Sprite(m_hud.getTexture()));
 
-  text.setString("Crossover Rate: " + std::to_string(gen.getCrossoverRate()));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 250);
-  m_window.draw(text);
+  /* Scrub bar, the filled part is the position of the displayed generation in the available ones */
+  size_t count = this -> getGenerationsCount();
+  m_scrubBar = sf::FloatRect(LEFT_PADDING + boardSize + 100, TOP_PADDING_SCRUB, GRAPH_SIZE_X, SCRUB_BAR_HEIGHT);
+  float progress = count > 1 ? static_cast<float>(std::min(m_visualisationIndex, count - 1)) / (count - 1) : 1.0f;
 
+  sf::RectangleShape bar(sf::Vector2f(m_scrubBar.width, m_scrubBar.height));
+  bar.setPosition(m_scrubBar.left, m_scrubBar.top);
+  bar.setFillColor(sf::Color(80, 76, 72, 255));
+  m_window.draw(bar);
 
-  text.setString("Average Fitness: " + std::to_string(gen.fitnessAverage()));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 300);
-  m_window.draw(text);
+  bar.setSize(sf::Vector2f(m_scrubBar.width * progress, m_scrubBar.height));
+  bar.setFillColor(sf::Color(118,150,86,255));
+  m_window.draw(bar);
 
-  text.setString("Best Fitness: " + std::to_string(gen.fitnessBest()));
-  text.setPosition(LEFT_PADDING + squareSize * m_dimension + 100, TOP_PADDING_TEXT + 350);
-  m_window.draw(text);
+  this -> drawGraph(LEFT_PADDING + boardSize + 100);
 
 }
 
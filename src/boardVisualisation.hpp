@@ -8,6 +8,9 @@
 #pragma once
 
 #include "geneticAlgorithm.hpp"
+#include "islandModel.hpp"
+#include "runLog.hpp"
+#include "fitnessSeries.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <vector>
@@ -16,6 +19,8 @@
 #include <unordered_map>
 #include <memory>
 #include <chrono>
+#include <cstdint>
+#include <tuple>
 
 // Represents position on the chess board
 using Position = std::pair<size_t, size_t>;
@@ -28,13 +33,25 @@ using Position = std::pair<size_t, size_t>;
 #define LEFT_PADDING_GRAPH 15.0f
 #define GRAPH_SIZE_X 450.0f
 #define GRAPH_SIZE_Y 300.0f
+#define TOP_PADDING_SCRUB 420.0f
+#define SCRUB_BAR_HEIGHT 12.0f
+#define SEEK_STEP_LARGE 100 // Generations skipped by Up/Down
+#define LOD_MIN_SQUARE_PIXELS 3.0f // Squares smaller than this (in pixels) show queens as density cells instead of sprites
+#define MIN_VISIBLE_SQUARES 8.0f // Zooming stops when this many squares are visible
+#define ZOOM_STEP 1.25f // Zoom of one mouse wheel step
+#define GRAPH_FEED_LIMIT 65536 // Maximal number of generations added to the fitness graph in one frame
+#define PAUSED_FRAMERATE 30 // Frame rate limit while paused
+#define PROFILE_PANEL_WIDTH 430.0f
+#define PROFILE_LINE_HEIGHT 22.0f
 
 class BoardVisualisation
 {
 public:
-  BoardVisualisation(size_t N, unsigned screenWidth, unsigned screenHeight)
+  BoardVisualisation(size_t N, unsigned screenWidth, unsigned screenHeight, uint64_t seed = Random::randomSeed(),
+                     size_t islands = ISLAND_COUNT, GeneticConfig config = GeneticConfig())
     : m_window(sf::RenderWindow (sf::VideoMode({screenWidth, screenHeight}), "N-Queens Visualisation")),
-  m_genetic(Genetic(N))
+  m_islands(N, seed, islands, MIGRATION_INTERVAL, MIGRANT_COUNT, MigrationTopology::Ring,
+            std::thread::hardware_concurrency(), config)
   {
     m_screenTitle = "N-Queens Visualisation";
     m_window.setFramerateLimit(360);
@@ -45,6 +62,27 @@ public:
     m_font.loadFromFile("assets/open_sans");
     m_visualisationIndex = 0;
     m_startVisualisation = false;
+    // Global best is shown by default
+    m_shownIsland = m_islands.getIslandCount();
+  }
+
+  /** Replays a recorded run (see RunLogWriter) instead of computing one, the log is memory mapped, so only
+      the displayed generation is read. Throws std::runtime_error if the log can not be opened */
+  BoardVisualisation(const std::string & logPath, unsigned screenWidth, unsigned screenHeight)
+    : m_window(sf::RenderWindow (sf::VideoMode({screenWidth, screenHeight}), "N-Queens Replay")),
+  m_replay(std::make_unique<RunLogReader>(logPath)),
+  m_islands(m_replay -> dimension(), m_replay -> seed(), 1)
+  {
+    m_screenTitle = "N-Queens Replay";
+    m_window.setFramerateLimit(360);
+
+    m_paused = false;
+    m_stepDelay = 0.0005f;
+    m_dimension = m_replay -> dimension();
+    m_font.loadFromFile("assets/open_sans");
+    m_visualisationIndex = 0;
+    m_startVisualisation = false;
+    m_shownIsland = 0;
   }
 
   /** Processes the user input during visualisation */
@@ -59,7 +97,65 @@ public:
   /** Displays the whole chess board */
   void showBoard(void);
 
+  /** Returns island that is displayed in the current generation */
+  size_t getDisplayedIsland(void);
+
+  /** Returns number of generations that can be displayed (computed so far or recorded) */
+  size_t getGenerationsCount(void);
+
+  /** Returns stats and the best individual of the displayed generation, nullptr if there is none yet */
+  const GenerationSummary * getDisplayedSummary(void);
+
+  /** Jumps to the generation (clamped to the generations that can be displayed) */
+  void seek(size_t index);
+
+  /** Zooms the board by the factor, the square under the pixel stays in place */
+  void zoom(float factor, sf::Vector2f pixel);
+
+  /** Moves the board by the pixel distance */
+  void pan(sf::Vector2f pixels);
+
 private:
+  /** Starts the solver thread (not in the replay mode) */
+  void startSolver(void);
+
+  /** Asks the solver to stop and waits for it, it stops within one generation (also if it is paused) */
+  void stopSolver(void);
+
+  /** Stops the solver and starts a new run with a new seed */
+  void restartSolver(void);
+
+  /** Creates the retained board geometry, the board is one quad in square units (the checkerboard is a repeated texture),
+      so it does not change with the window size or zoom */
+  void buildBoard(void);
+
+  /** Returns view of the visible part of the board placed into m_boardArea */
+  sf::View boardView(void);
+
+  /** Rebuilds the batched queens of the generation if the generation or the visible part of the board changed.
+      Only queens in the visible part are added, one textured quad each, or density cells of several squares
+      if the squares are smaller than LOD_MIN_SQUARE_PIXELS */
+  void updateQueens(const GenerationSummary & generation, size_t island);
+
+  /** Adds the generations computed (or read from the log) since the last frame to the fitness series */
+  void feedGraph(void);
+
+  /** Returns index of the series of the displayed island in m_series */
+  size_t getGraphSeries(void);
+
+  /** Updates the graph vertices from the series, only the last bucket is rewritten and new buckets are appended,
+      all vertices are rebuilt (from the buckets) only if the series was merged or another series is shown */
+  void updateGraph(void);
+
+  /** Draws the fitness graph and the marker of the displayed generation */
+  void drawGraph(float left);
+
+  /** Draws the stats of the generation */
+  void renderHud(sf::RenderTarget & target, const GenerationSummary & gen, size_t island, float boardSize);
+
+  /** Draws time of the phases of the generation (see PhaseProfile) over the board */
+  void renderProfile(sf::RenderTarget & target, const GenerationSummary & gen, size_t island);
+
   sf::RenderWindow m_window;
   std::string m_screenTitle;
   bool m_paused;
@@ -71,7 +167,49 @@ private:
   float m_stepDelay;
   std::chrono::high_resolution_clock::time_point m_startTime;
 
-  Genetic m_genetic;
+  // Recorded run, null if the run is computed
+  std::unique_ptr<RunLogReader> m_replay;
+  // Summary of the replayed generation m_replayIndex, read from the log only when the index changes
+  GenerationSummary m_replaySummary;
+  size_t m_replayIndex = SIZE_MAX;
+  // Scrub bar area (set by showBoard), dragging the mouse over it seeks
+  sf::FloatRect m_scrubBar;
+  bool m_scrubbing = false;
+
+  /* Board is drawn in square units through a view, zoom 1 shows the whole board */
+  sf::FloatRect m_boardArea;
+  float m_zoom = 1.0f;
+  sf::Vector2f m_viewCenter;
+  bool m_panning = false;
+  sf::Vector2i m_panStart;
+  // Retained board quad and the checkerboard (or its average colour, if the squares are too small) textures
+  sf::VertexBuffer m_boardBuffer {sf::Quads, sf::VertexBuffer::Static};
+  sf::Vertex m_boardVertices[4];
+  sf::Texture m_boardTexture;
+  sf::Texture m_boardFlatTexture;
+  bool m_boardBuilt = false;
+  // Queens of the displayed generation, rebuilt only when m_queensKey changes
+  sf::VertexArray m_queens {sf::Quads};
+  bool m_queensTextured = true;
+  std::vector<uint32_t> m_densityCells;
+  std::tuple<size_t, size_t, float, float, float, size_t> m_queensKey {SIZE_MAX, SIZE_MAX, 0, 0, 0, 0};
+  /* Fitness graph, one series per island and one of the best island (if there are more islands) */
+  std::vector<FitnessSeries> m_series;
+  sf::VertexArray m_graphBest {sf::LineStrip};
+  sf::VertexArray m_graphAverage {sf::LineStrip};
+  size_t m_graphSeries = SIZE_MAX;
+  size_t m_graphMerges = 0;
+  // Stats panel, rendered again only when m_hudKey (displayed generation, island, window size, profile panel, max of the
+  // graph legend) changes
+  sf::RenderTexture m_hud;
+  std::tuple<size_t, size_t, size_t, size_t, unsigned, unsigned, bool, double> m_hudKey {SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX, 0, 0, false, 0};
+  bool m_showProfile = false;
+
+  IslandModel m_islands;
+  // Runs m_islands, stopped through the stop token of the islands
+  std::thread m_solver;
+  // Displayed island, getIslandCount() means the island with the best individual
+  size_t m_shownIsland;
   size_t m_visualisationIndex;
   bool m_startVisualisation;
 };
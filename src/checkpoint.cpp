@@ -0,0 +1,184 @@
+/**
+ * @file checkpoint.cpp
+ * @author Ondrej
+ * @brief Binary checkpoints of a run, written in the background and read back to resume the run
+ *
+*/
+
+#include "checkpoint.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+/** Appends size bytes */
+void CheckpointBuffer::putBytes(const void * data, size_t size)
+{
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+}
+
+/** Returns the serialised bytes */
+const std::vector<unsigned char> & CheckpointBuffer::bytes(void) const
+{
+  return m_bytes;
+}
+
+/** Moves the serialised bytes out of the buffer */
+std::vector<unsigned char> CheckpointBuffer::release(void)
+{
+  std::vector<unsigned char> bytes;
+  std::swap(bytes, m_bytes);
+  return bytes;
+}
+
+CheckpointReader::CheckpointReader(const std::string & path)
+  : m_path(path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    throw std::runtime_error("Can not open checkpoint " + path);
+
+  m_bytes.resize(file.tellg());
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char *>(m_bytes.data()), m_bytes.size()))
+    throw std::runtime_error("Can not read checkpoint " + path);
+}
+
+/** Copies the next size bytes, throws std::runtime_error if the file is shorter */
+void CheckpointReader::getBytes(void * data, size_t size)
+{
+  if (size > m_bytes.size() - m_position)
+    throw std::runtime_error("Checkpoint " + m_path + " is truncated");
+
+  std::memcpy(data, m_bytes.data() + m_position, size);
+  m_position += size;
+}
+
+/** Returns true if the whole file was read */
+bool CheckpointReader::atEnd(void) const
+{
+  return m_position == m_bytes.size();
+}
+
+/** Returns number of bytes that were not read yet */
+size_t CheckpointReader::remaining(void) const
+{
+  return m_bytes.size() - m_position;
+}
+
+/** Returns path of the file */
+const std::string & CheckpointReader::path(void) const
+{
+  return m_path;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string & path)
+  : m_path(path)
+{
+  /* Fails now rather than at the first checkpoint, the existing checkpoint (e.g. the resumed one) is kept */
+  std::string temporary = path + ".tmp";
+  if (!std::ofstream(temporary, std::ios::binary))
+    throw std::runtime_error("Can not create checkpoint " + path);
+  std::remove(temporary.c_str());
+
+  m_writer = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+/** Writes the last checkpoint (errors are ignored, call close to see them) */
+CheckpointWriter::~CheckpointWriter()
+{
+  this -> finish();
+}
+
+/** Hands the checkpoint over to the writer thread */
+void CheckpointWriter::submit(std::vector<unsigned char> checkpoint)
+{
+  if (m_closed)
+    throw std::logic_error("Checkpoint " + m_path + " is closed");
+
+  {
+    std::unique_lock<std::mutex> lock (m_mtx);
+    m_pending = std::move(checkpoint);
+  }
+  m_wake.notify_one();
+}
+
+/** Writes the last checkpoint and stops the thread, throws std::runtime_error if writing failed */
+void CheckpointWriter::close(void)
+{
+  if (!this -> finish())
+    throw std::runtime_error("Can not write checkpoint " + m_path);
+}
+
+/** Returns number of checkpoints written so far */
+size_t CheckpointWriter::written(void) const
+{
+  return m_written;
+}
+
+/** Writes the submitted checkpoints until the writer is closed */
+void CheckpointWriter::writerLoop(void)
+{
+  std::vector<unsigned char> writing;
+  std::unique_lock<std::mutex> lock (m_mtx);
+  while (true)
+  {
+    m_wake.wait(lock, [this] ()
+    {
+      return m_stopping || !m_pending.empty();
+    });
+
+    /* The run can submit the next checkpoint while this one is written */
+    std::swap(m_pending, writing);
+    bool stopping = m_stopping;
+    lock.unlock();
+
+    if (!writing.empty())
+    {
+      if (this -> write(writing))
+        m_written ++;
+      else
+        m_failed = true;
+      writing.clear();
+    }
+
+    lock.lock();
+    if (stopping && m_pending.empty())
+      return;
+  }
+}
+
+/** Writes the checkpoint into the temporary file and renames it, returns false on an error */
+bool CheckpointWriter::write(const std::vector<unsigned char> & checkpoint)
+{
+  std::string temporary = m_path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char *>(checkpoint.data()), checkpoint.size()))
+      return false;
+    file.close();
+    if (!file)
+      return false;
+  }
+
+  return std::rename(temporary.c_str(), m_path.c_str()) == 0;
+}
+
+/** Stops the writer thread, returns false if some write failed */
+bool CheckpointWriter::finish(void)
+{
+  if (m_closed)
+    return !m_failed;
+  m_closed = true;
+
+  {
+    std::unique_lock<std::mutex> lock (m_mtx);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_writer.join();
+
+  return !m_failed;
+}
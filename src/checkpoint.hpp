@@ -0,0 +1,150 @@
+/**
+ * @file checkpoint.hpp
+ * @author Ondrej
+ * @brief Binary checkpoints of a run, written in the background and read back to resume the run
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_INTERVAL 500 // Generations between checkpoints (has to be a multiple of the migration interval)
+
+/* Layout of the file (native byte order, like the run log, so it is read back by the same build):
+   CheckpointHeader | GeneticConfig | state of island 0 | state of island 1 | ...
+   State of an island is written by Genetic::saveState */
+
+/** Start of the file */
+struct CheckpointHeader
+{
+  char magic[8];
+  uint32_t version;
+  // sizeof(GeneticConfig) of the build that wrote the checkpoint
+  uint32_t configSize;
+  uint64_t dimension;
+  uint64_t seed;
+  uint64_t islands;
+  uint64_t migrationInterval;
+  uint64_t migrants;
+  uint64_t topology;
+  // Index of the last generation of every island
+  uint64_t generation;
+};
+
+/** Memory buffer the state is serialised into */
+class CheckpointBuffer
+{
+public:
+  /** Appends the value */
+  template <typename T>
+  void put(const T & value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written into a checkpoint");
+    this -> putBytes(&value, sizeof(value));
+  }
+
+  /** Appends size bytes */
+  void putBytes(const void * data, size_t size);
+
+  /** Returns the serialised bytes */
+  const std::vector<unsigned char> & bytes(void) const;
+
+  /** Moves the serialised bytes out of the buffer, the buffer is empty afterwards */
+  std::vector<unsigned char> release(void);
+
+private:
+  std::vector<unsigned char> m_bytes;
+};
+
+/** Reads the values of a checkpoint file in the order they were written */
+class CheckpointReader
+{
+public:
+  /** Reads the whole file, throws std::runtime_error if it can not be read */
+  explicit CheckpointReader(const std::string & path);
+
+  /** Returns the next value */
+  template <typename T>
+  T get(void)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read from a checkpoint");
+    T value;
+    this -> getBytes(&value, sizeof(value));
+    return value;
+  }
+
+  /** Copies the next size bytes, throws std::runtime_error if the file is shorter */
+  void getBytes(void * data, size_t size);
+
+  /** Returns true if the whole file was read */
+  bool atEnd(void) const;
+
+  /** Returns number of bytes that were not read yet */
+  size_t remaining(void) const;
+
+  /** Returns path of the file */
+  const std::string & path(void) const;
+
+private:
+  std::string m_path;
+  std::vector<unsigned char> m_bytes;
+  size_t m_position = 0;
+};
+
+/** Writes checkpoints by a background thread, so the run only serialises its state into memory.
+    Every checkpoint is written into a temporary file that replaces the old checkpoint by rename, so the file always
+    holds a whole checkpoint even if the process is killed while writing. If the disk is slower than the run,
+    a checkpoint that was not written yet is replaced by the newer one */
+class CheckpointWriter
+{
+public:
+  /** Starts the writer thread, throws std::runtime_error if the file can not be created */
+  explicit CheckpointWriter(const std::string & path);
+
+  /** Writes the last checkpoint (errors are ignored, call close to see them) */
+  ~CheckpointWriter();
+
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter & operator=(const CheckpointWriter &) = delete;
+
+  /** Hands the checkpoint over to the writer thread */
+  void submit(std::vector<unsigned char> checkpoint);
+
+  /** Writes the last checkpoint and stops the thread, throws std::runtime_error if writing failed */
+  void close(void);
+
+  /** Returns number of checkpoints written so far */
+  size_t written(void) const;
+
+private:
+  /** Writes the submitted checkpoints until the writer is closed */
+  void writerLoop(void);
+
+  /** Writes the checkpoint into the temporary file and renames it, returns false on an error */
+  bool write(const std::vector<unsigned char> & checkpoint);
+
+  /** Stops the writer thread, returns false if some write failed */
+  bool finish(void);
+
+  std::string m_path;
+  bool m_closed = false;
+
+  /* Newest checkpoint waiting for the writer thread (empty if there is none) */
+  std::vector<unsigned char> m_pending;
+  bool m_stopping = false;
+  std::atomic<bool> m_failed {false};
+  std::atomic<size_t> m_written {0};
+  std::mutex m_mtx;
+  std::condition_variable m_wake;
+  std::thread m_writer;
+};
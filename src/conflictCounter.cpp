@@ -0,0 +1,88 @@
+/**
+ * @file conflictCounter.cpp
+ * @author Ondrej
+ * @brief Counts attacking queen pairs using column and diagonal occupancy histograms
+ *
+*/
+
+#include "conflictCounter.hpp"
+
+/** Rebuilds the histograms from the individual in a single pass */
+void ConflictCounter::assign(const std::vector<size_t> & individual, bool hashed)
+{
+  m_dimension = individual.size();
+  m_hashed = hashed;
+  m_conflicts = 0;
+  m_hash = 0;
+
+  /* assign() keeps the capacity, so reusing one counter does not allocate */
+  m_columns.assign(m_dimension, 0);
+  m_diagonals.assign(m_dimension == 0 ? 0 : 2 * m_dimension - 1, 0);
+  m_antiDiagonals.assign(m_dimension == 0 ? 0 : 2 * m_dimension - 1, 0);
+
+  for (size_t row = 0; row < m_dimension; row ++)
+  {
+    this -> addQueen(row, individual[row]);
+  }
+}
+
+/** Places queen on (row, column) and returns number of queens it attacks */
+size_t ConflictCounter::addQueen(size_t row, size_t column)
+{
+  uint32_t & col = m_columns[column];
+  uint32_t & diag = m_diagonals[row + m_dimension - 1 - column];
+  uint32_t & anti = m_antiDiagonals[row + column];
+
+  // Every queen already on one of the lines forms a new attacking pair
+  size_t attacks = col + diag + anti;
+  col ++;
+  diag ++;
+  anti ++;
+
+  m_conflicts += attacks;
+  if (m_hashed)
+    m_hash ^= ConflictCounter::zobristKey(row, column);
+  return attacks;
+}
+
+/** Removes queen from (row, column) and returns number of queens it attacked */
+size_t ConflictCounter::removeQueen(size_t row, size_t column)
+{
+  uint32_t & col = m_columns[column];
+  uint32_t & diag = m_diagonals[row + m_dimension - 1 - column];
+  uint32_t & anti = m_antiDiagonals[row + column];
+
+  col --;
+  diag --;
+  anti --;
+  size_t attacks = col + diag + anti;
+
+  m_conflicts -= attacks;
+  if (m_hashed)
+    m_hash ^= ConflictCounter::zobristKey(row, column);
+  return attacks;
+}
+
+/** Returns number of attacking queen pairs */
+size_t ConflictCounter::conflicts(void) const
+{
+  return m_conflicts;
+}
+
+/** Returns hash of the genome, equal genomes have equal hashes (always 0 if the counter does not keep the hash) */
+uint64_t ConflictCounter::hash(void) const
+{
+  return m_hash;
+}
+
+/** Returns true if the counter keeps the hash of the genome */
+bool ConflictCounter::hashed(void) const
+{
+  return m_hashed;
+}
+
+/** Returns board size */
+size_t ConflictCounter::dimension(void) const
+{
+  return m_dimension;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file conflictCounter.hpp
+ * @author Ondrej
+ * @brief Counts attacking queen pairs using column and diagonal occupancy histograms
+ *
+*/
+
+#pragma once
+
+#include "random.hpp"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/** Keeps occupancy histograms of the columns, main diagonals and anti-diagonals of one individual.
+    Number of conflicts is the number of queen pairs sharing a column or a diagonal, which is exactly
+    the score of the pairwise Generation::attackCount definition, but it is computed in O(N).
+    It can also keep a Zobrist hash of the genome (XOR of the keys of all queens), so every gene change updates
+    the hash in O(1) together with the histograms. Mixing the keys is the most expensive part of a queen move, so
+    runs without the fitness cache assign their counters without the hash */
+class ConflictCounter
+{
+public:
+  ConflictCounter() = default;
+
+  explicit ConflictCounter(const std::vector<size_t> & individual)
+  {
+    this -> assign(individual);
+  };
+
+  /** Rebuilds the histograms from the individual in a single pass, the hash is kept only if hashed is true */
+  void assign(const std::vector<size_t> & individual, bool hashed = true);
+
+  /** Places queen on (row, column) and returns number of queens it attacks */
+  size_t addQueen(size_t row, size_t column);
+
+  /** Removes queen from (row, column) and returns number of queens it attacked */
+  size_t removeQueen(size_t row, size_t column);
+
+  /** Returns number of queens on the column and diagonals of (row, column) in O(1), that is the number of queens
+      a queen added there would attack (a queen already standing there is counted on each of its three lines) */
+  size_t attacks(size_t row, size_t column) const
+  {
+    return m_columns[column] + m_diagonals[row + m_dimension - 1 - column] + m_antiDiagonals[row + column];
+  };
+
+  /** Returns number of attacking queen pairs */
+  size_t conflicts(void) const;
+
+  /** Returns hash of the genome, equal genomes have equal hashes (always 0 if the counter does not keep the hash) */
+  uint64_t hash(void) const;
+
+  /** Returns true if the counter keeps the hash of the genome */
+  bool hashed(void) const;
+
+  /** Returns Zobrist key of the queen on (row, column). Keys are mixed from the position instead of being
+      stored in an N x N table of random numbers, which would not fit into the cache for large boards */
+  static uint64_t zobristKey(size_t row, size_t column)
+  {
+    return Random::mix((static_cast<uint64_t>(row) << 32) ^ column);
+  };
+
+  /** Returns board size */
+  size_t dimension(void) const;
+
+private:
+  size_t m_dimension = 0;
+  size_t m_conflicts = 0;
+  uint64_t m_hash = 0;
+  bool m_hashed = true;
+  std::vector<uint32_t> m_columns;
+  // Main diagonal of (row, column) is row - column + N - 1, anti-diagonal is row + column
+  std::vector<uint32_t> m_diagonals;
+  std::vector<uint32_t> m_antiDiagonals;
+};
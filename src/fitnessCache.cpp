@@ -0,0 +1,97 @@
+/**
+ * @file fitnessCache.cpp
+ * @author Ondrej
+ * @brief Bounded memo of the genomes evaluated in a run, keyed on their Zobrist hash
+ *
+*/
+
+#include "fitnessCache.hpp"
+#include "checkpoint.hpp"
+
+#include <stdexcept>
+
+/** Returns share of the lookups that found the genome (hits and duplicates) */
+double FitnessCacheStats::hitRate(void) const
+{
+  return lookups == 0 ? 0 : static_cast<double>(hits + duplicates) / lookups;
+}
+
+/** Adds counters of another cache */
+FitnessCacheStats & FitnessCacheStats::operator+=(const FitnessCacheStats & other)
+{
+  lookups += other.lookups;
+  hits += other.hits;
+  duplicates += other.duplicates;
+  rejected += other.rejected;
+  return *this;
+}
+
+FitnessCache::FitnessCache(size_t size)
+  : m_slots(size)
+{
+  if ((size & (size - 1)) != 0)
+    throw std::invalid_argument("Size of the fitness cache must be a power of two");
+}
+
+/** Looks the genome of the generation up and records it */
+CacheLookup FitnessCache::visit(uint64_t hash, double fitness, size_t generation)
+{
+  if (m_slots.empty())
+    return CacheLookup::Miss;
+
+  m_stats.lookups ++;
+
+  // Low bits of the hash pick the slot, the whole hash is compared
+  Slot & slot = m_slots[hash & (m_slots.size() - 1)];
+  const uint64_t stamp = generation + 1;
+
+  CacheLookup result = CacheLookup::Miss;
+  if (slot.generation != 0 && slot.hash == hash && slot.fitness == fitness)
+    result = slot.generation == stamp ? CacheLookup::Duplicate : CacheLookup::Hit;
+
+  if (result == CacheLookup::Hit)
+    m_stats.hits ++;
+  else if (result == CacheLookup::Duplicate)
+    m_stats.duplicates ++;
+
+  slot.hash = hash;
+  slot.fitness = fitness;
+  slot.generation = stamp;
+  return result;
+}
+
+/** Returns number of slots */
+size_t FitnessCache::size(void) const
+{
+  return m_slots.size();
+}
+
+/** Returns the counters */
+const FitnessCacheStats & FitnessCache::stats(void) const
+{
+  return m_stats;
+}
+
+/** Counts a duplicate that was mutated again */
+void FitnessCache::countRejected(void)
+{
+  m_stats.rejected ++;
+}
+
+/** Writes the slots and the counters into the checkpoint */
+void FitnessCache::save(CheckpointBuffer & buffer) const
+{
+  buffer.put<uint64_t>(m_slots.size());
+  buffer.putBytes(m_slots.data(), m_slots.size() * sizeof(Slot));
+  buffer.put(m_stats);
+}
+
+/** Reads the slots and the counters written by save */
+void FitnessCache::restore(CheckpointReader & reader)
+{
+  if (reader.get<uint64_t>() != m_slots.size())
+    throw std::runtime_error("Fitness cache of checkpoint " + reader.path() + " has a different size");
+
+  reader.getBytes(m_slots.data(), m_slots.size() * sizeof(Slot));
+  m_stats = reader.get<FitnessCacheStats>();
+}
@@ -0,0 +1,82 @@
+/**
+ * @file fitnessCache.hpp
+ * @author Ondrej
+ * @brief Bounded memo of the genomes evaluated in a run, keyed on their Zobrist hash
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#define FITNESS_CACHE_SIZE 0 // Slots of the cache of one run (power of two, 0 turns the cache and the genome hashes off)
+
+class CheckpointBuffer;
+class CheckpointReader;
+
+/** Result of looking a genome up in the cache */
+enum class CacheLookup
+{
+  Miss, // Genome was not seen (or its slot was taken by another genome since)
+  Hit, // Genome was seen in an earlier generation
+  Duplicate // Genome was already seen in the same generation
+};
+
+/** Counters of the cache */
+struct FitnessCacheStats
+{
+  size_t lookups = 0;
+  size_t hits = 0;
+  size_t duplicates = 0;
+  // Duplicates that were mutated again, counted by the caller
+  size_t rejected = 0;
+
+  /** Returns share of the lookups that found the genome (hits and duplicates) */
+  double hitRate(void) const;
+
+  /** Adds counters of another cache */
+  FitnessCacheStats & operator+=(const FitnessCacheStats & other);
+};
+
+/** Direct-mapped table of (hash, fitness, generation) slots, a new genome replaces the one in its slot, so the memory
+    stays the same for the whole run. A slot matches only if both the hash and the fitness are equal, the fitness
+    guards against the rare hash collisions of two different genomes */
+class FitnessCache
+{
+public:
+  /** Creates cache with size slots, throws std::invalid_argument if size is not a power of two (or 0) */
+  explicit FitnessCache(size_t size = 0);
+
+  /** Looks the genome of the generation up and records it */
+  CacheLookup visit(uint64_t hash, double fitness, size_t generation);
+
+  /** Returns number of slots */
+  size_t size(void) const;
+
+  /** Returns the counters */
+  const FitnessCacheStats & stats(void) const;
+
+  /** Counts a duplicate that was mutated again */
+  void countRejected(void);
+
+  /** Writes the slots and the counters into the checkpoint */
+  void save(CheckpointBuffer & buffer) const;
+
+  /** Reads the slots and the counters written by save, throws std::runtime_error if the number of slots differs */
+  void restore(CheckpointReader & reader);
+
+private:
+  /** One remembered genome */
+  struct Slot
+  {
+    uint64_t hash = 0;
+    double fitness = 0;
+    // Generation index + 1 of the last occurrence, 0 if the slot is empty
+    uint64_t generation = 0;
+  };
+
+  std::vector<Slot> m_slots;
+  FitnessCacheStats m_stats;
+};
@@ -0,0 +1,116 @@
+/**
+ * @file fitnessSeries.cpp
+ * @author Ondrej
+ * @brief Fixed-size downsampled series of the best and average fitness of a run
+ *
+*/
+
+#include "fitnessSeries.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+FitnessSeries::FitnessSeries(size_t capacity)
+  : m_capacity(capacity)
+{
+  if (capacity < 2 || capacity % 2 != 0)
+    throw std::invalid_argument("Fitness series needs an even number of buckets");
+
+  m_buckets.reserve(capacity);
+}
+
+/** Appends stats of the next generation, returns true if the buckets were merged */
+bool FitnessSeries::append(double best, double average)
+{
+  bool merged = false;
+
+  if (m_buckets.empty() || m_buckets.back().count == m_width)
+  {
+    /* All buckets are full, pairs of buckets are merged into the first half and the width doubles */
+    if (m_buckets.size() == m_capacity)
+    {
+      for (size_t i = 0; i < m_capacity / 2; i ++)
+      {
+        const FitnessBucket & first = m_buckets[2 * i];
+        const FitnessBucket & second = m_buckets[2 * i + 1];
+
+        FitnessBucket bucket;
+        bucket.firstGeneration = first.firstGeneration;
+        bucket.count = first.count + second.count;
+        bucket.minBest = std::min(first.minBest, second.minBest);
+        bucket.maxBest = std::max(first.maxBest, second.maxBest);
+        bucket.minAverage = std::min(first.minAverage, second.minAverage);
+        bucket.maxAverage = std::max(first.maxAverage, second.maxAverage);
+        m_buckets[i] = bucket;
+      }
+
+      m_buckets.resize(m_capacity / 2);
+      m_width *= 2;
+      m_merges ++;
+      merged = true;
+    }
+
+    FitnessBucket bucket;
+    bucket.firstGeneration = m_size;
+    bucket.minBest = bucket.maxBest = best;
+    bucket.minAverage = bucket.maxAverage = average;
+    m_buckets.push_back(bucket);
+  }
+
+  FitnessBucket & bucket = m_buckets.back();
+  bucket.count ++;
+  bucket.minBest = std::min(bucket.minBest, best);
+  bucket.maxBest = std::max(bucket.maxBest, best);
+  bucket.minAverage = std::min(bucket.minAverage, average);
+  bucket.maxAverage = std::max(bucket.maxAverage, average);
+
+  m_maxFitness = std::max({m_maxFitness, best, average});
+  m_size ++;
+  return merged;
+}
+
+/** Removes all generations */
+void FitnessSeries::clear(void)
+{
+  m_buckets.clear();
+  m_width = 1;
+  m_size = 0;
+  m_merges = 0;
+  m_maxFitness = 0;
+}
+
+/** Returns number of appended generations */
+size_t FitnessSeries::size(void) const
+{
+  return m_size;
+}
+
+/** Returns the buckets */
+const std::vector<FitnessBucket> & FitnessSeries::buckets(void) const
+{
+  return m_buckets;
+}
+
+/** Returns maximal number of buckets */
+size_t FitnessSeries::capacity(void) const
+{
+  return m_capacity;
+}
+
+/** Returns number of generations of one bucket */
+size_t FitnessSeries::bucketWidth(void) const
+{
+  return m_width;
+}
+
+/** Returns number of merges so far */
+size_t FitnessSeries::merges(void) const
+{
+  return m_merges;
+}
+
+/** Returns the largest fitness (best or average) of all generations */
+double FitnessSeries::maxFitness(void) const
+{
+  return m_maxFitness;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file fitnessSeries.hpp
+ * @author Ondrej
+ * @brief Fixed-size downsampled series of the best and average fitness of a run
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#define FITNESS_SERIES_BUCKETS 256 // Number of buckets of the series (has to be even)
+
+/** Range of the fitness of consecutive generations */
+struct FitnessBucket
+{
+  size_t firstGeneration = 0;
+  size_t count = 0;
+  double minBest = 0;
+  double maxBest = 0;
+  double minAverage = 0;
+  double maxAverage = 0;
+};
+
+/** Min/max bucketing of the fitness of every generation: every bucket covers bucketWidth() generations, when all
+    buckets are full, neighbouring buckets are merged and the width doubles. Memory and the number of buckets to draw
+    stay the same whether the run has 100 or 10,000,000 generations, appending is O(1) amortised */
+class FitnessSeries
+{
+public:
+  explicit FitnessSeries(size_t capacity = FITNESS_SERIES_BUCKETS);
+
+  /** Appends stats of the next generation, returns true if the buckets were merged (all of them changed) */
+  bool append(double best, double average);
+
+  /** Removes all generations */
+  void clear(void);
+
+  /** Returns number of appended generations */
+  size_t size(void) const;
+
+  /** Returns the buckets, only the last one can change on append (unless the buckets are merged) */
+  const std::vector<FitnessBucket> & buckets(void) const;
+
+  /** Returns maximal number of buckets */
+  size_t capacity(void) const;
+
+  /** Returns number of generations of one bucket */
+  size_t bucketWidth(void) const;
+
+  /** Returns number of merges so far, changes whenever the buckets are merged */
+  size_t merges(void) const;
+
+  /** Returns the largest fitness (best or average) of all generations */
+  double maxFitness(void) const;
+
+private:
+  size_t m_capacity;
+  size_t m_width = 1;
+  size_t m_size = 0;
+  size_t m_merges = 0;
+  double m_maxFitness = 0;
+  std::vector<FitnessBucket> m_buckets;
+};
@@ -0,0 +1,76 @@
+/**
+ * @file fixedKernels.hpp
+ * @author Ondrej
+ * @brief Fitness kernels specialised for board sizes known at compile time
+ *
+ * The kernels score a whole board from scratch, they are used by Generation::getFitness (individuals that come
+ * without a counter, e.g. generations read back from a run log, and the benchmarks). The genetic algorithm itself
+ * scores through ConflictCounter, whose histograms it keeps for the incremental updates of the children
+*/
+
+#pragma once
+
+#include "conflictCounter.hpp"
+
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/** Counts attacking queen pairs of the individual, the result is the same as ConflictCounter::conflicts() */
+using ConflictKernel = size_t (*)(const std::vector<size_t> & individual);
+
+/** Conflicts of a board whose size is a compile-time constant. Histograms are fixed-size arrays on the stack
+    (no allocation, no bounds from memory) and the loop has a constant trip count, so the compiler unrolls it */
+template <size_t N>
+size_t fixedConflicts(const std::vector<size_t> & individual)
+{
+  // N queens fit into one byte per line for every specialised size
+  static_assert(N <= UINT8_MAX, "Histogram counters are one byte wide");
+
+  std::array<uint8_t, N> columns {};
+  std::array<uint8_t, 2 * N - 1> diagonals {};
+  std::array<uint8_t, 2 * N - 1> antiDiagonals {};
+  const size_t * genes = individual.data();
+
+  size_t conflicts = 0;
+  for (size_t row = 0; row < N; row ++)
+  {
+    size_t column = genes[row];
+    // Every queen already on one of the lines forms a new attacking pair (see ConflictCounter::addQueen)
+    conflicts += columns[column] ++;
+    conflicts += diagonals[row + N - 1 - column] ++;
+    conflicts += antiDiagonals[row + column] ++;
+  }
+
+  return conflicts;
+}
+
+/** Conflicts of a board of any size */
+inline size_t genericConflicts(const std::vector<size_t> & individual)
+{
+  // One counter per thread, so the histograms are not reallocated for every individual
+  static thread_local ConflictCounter counter;
+  counter.assign(individual);
+  return counter.conflicts();
+}
+
+/** Returns the specialised kernel for the board size or the generic one */
+inline ConflictKernel selectConflictKernel(size_t N)
+{
+  switch (N)
+  {
+    case 8:
+      return fixedConflicts<8>;
+    case 16:
+      return fixedConflicts<16>;
+    case 32:
+      return fixedConflicts<32>;
+    case 64:
+      return fixedConflicts<64>;
+    case 128:
+      return fixedConflicts<128>;
+    default:
+      return genericConflicts;
+  }
+}
@@ -0,0 +1,150 @@
+/**
+ * @file generationHistory.cpp
+ * @author Ondrej
+ * @brief Bounded memory history of the generations of one run
+ *
+*/
+
+#include "generationHistory.hpp"
+#include "geneticAlgorithm.hpp"
+
+#include <stdexcept>
+
+GenerationHistory::GenerationHistory(size_t retention, size_t stride)
+  : m_retention(retention),
+    m_stride(stride),
+    m_chunks(new std::atomic<Chunk *>[SUMMARY_MAX_CHUNKS])
+{
+  for (size_t i = 0; i < SUMMARY_MAX_CHUNKS; i ++)
+    m_chunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+GenerationHistory::~GenerationHistory()
+{
+  for (size_t i = 0; i < SUMMARY_MAX_CHUNKS; i ++)
+  {
+    delete m_chunks[i].load(std::memory_order_relaxed);
+  }
+}
+
+/** Sets how many whole generations are kept, has to be called before the first push */
+void GenerationHistory::setLimits(size_t retention, size_t stride)
+{
+  if (this -> size() != 0)
+    throw std::logic_error("History limits can not change during the run");
+
+  m_retention = retention;
+  m_stride = stride;
+}
+
+/** Adds generation to the history */
+void GenerationHistory::push(Generation & generation)
+{
+  size_t index = m_size.load(std::memory_order_relaxed);
+  GenerationSummary & summary = this -> nextSummary();
+  summary.index = index;
+  summary.mutationRate = generation.getMutationRate();
+  summary.crossoverRate = generation.getCrossoverRate();
+  summary.averageFitness = generation.fitnessAverage();
+
+  /* Generation keeps its best individual, no scan is needed */
+  if (generation.size() != 0)
+  {
+    size_t best = generation.bestIndex();
+    summary.bestFitness = generation.fitnessBest();
+    summary.bestIndividual = generation.getIndividual(best);
+  }
+
+  this -> retain(generation, index);
+
+  /* Publishes the summary, readers that see the new size see the whole summary */
+  m_size.store(index + 1, std::memory_order_release);
+}
+
+/** Adds summary of a generation whose population is gone */
+void GenerationHistory::pushSummary(const GenerationSummary & summary)
+{
+  size_t index = m_size.load(std::memory_order_relaxed);
+  GenerationSummary & published = this -> nextSummary();
+  published = summary;
+  published.index = index;
+
+  // Recent generations are looked up by index, so the summary takes the place of the population
+  Generation generation(published);
+  this -> retain(generation, index);
+
+  m_size.store(index + 1, std::memory_order_release);
+}
+
+/** Returns unpublished slot of the next summary, allocates its chunk if needed */
+GenerationSummary & GenerationHistory::nextSummary(void)
+{
+  size_t index = m_size.load(std::memory_order_relaxed);
+  if (index >= SUMMARY_CHUNK_SIZE * SUMMARY_MAX_CHUNKS)
+    throw std::length_error("Too many generations");
+
+  /* Summary is written into its final place before it is published */
+  Chunk * chunk = m_chunks[index / SUMMARY_CHUNK_SIZE].load(std::memory_order_relaxed);
+  if (chunk == nullptr)
+  {
+    chunk = new Chunk();
+    m_chunks[index / SUMMARY_CHUNK_SIZE].store(chunk, std::memory_order_release);
+  }
+
+  return chunk -> summaries[index % SUMMARY_CHUNK_SIZE];
+}
+
+/** Keeps the whole generation if it is one of the recent or the sampled ones */
+void GenerationHistory::retain(Generation & generation, size_t index)
+{
+  if (m_retention != 0)
+  {
+    if (m_recent.size() < m_retention)
+      m_recent.push_back(generation);
+    else
+      m_recent[index % m_retention] = generation;
+  }
+
+  if (m_stride != 0 && index % m_stride == 0)
+    m_sampled.push_back(generation);
+}
+
+/** Returns number of published generations (lock-free) */
+size_t GenerationHistory::size(void) const
+{
+  return m_size.load(std::memory_order_acquire);
+}
+
+/** Returns summary of the Nth generation, the reference stays valid for the lifetime of the history (lock-free) */
+const GenerationSummary & GenerationHistory::getSummary(size_t N) const
+{
+  if (N >= this -> size())
+    throw std::out_of_range("Generation Out of range");
+
+  return m_chunks[N / SUMMARY_CHUNK_SIZE].load(std::memory_order_acquire) -> summaries[N % SUMMARY_CHUNK_SIZE];
+}
+
+/** Returns true if the whole population of the Nth generation is kept */
+bool GenerationHistory::isRetained(size_t N) const
+{
+  size_t size = this -> size();
+  if (N >= size)
+    return false;
+
+  return (m_retention != 0 && N + m_retention >= size) || (m_stride != 0 && N % m_stride == 0);
+}
+
+/** Returns the Nth generation, if its population is not kept, returned generation holds only its best individual
+    (with the stats of the whole generation) */
+Generation GenerationHistory::getGeneration(size_t N) const
+{
+  const GenerationSummary & summary = this -> getSummary(N);
+
+  if (m_retention != 0 && N + m_retention >= this -> size())
+    return m_recent[N % m_retention];
+
+  if (m_stride != 0 && N % m_stride == 0)
+    return m_sampled[N / m_stride];
+
+  return Generation(summary);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file generationHistory.hpp
+ * @author Ondrej
+ * @brief Bounded memory history of the generations of one run
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+#define HISTORY_RETENTION 100 // Number of the last generations kept with the whole population
+#define HISTORY_STRIDE 0 // Every HISTORY_STRIDE-th generation is kept with the whole population forever (0 means none)
+#define SUMMARY_CHUNK_SIZE 4096 // Summaries are allocated in chunks that never move
+#define SUMMARY_MAX_CHUNKS 16384 // Maximal number of generations is SUMMARY_CHUNK_SIZE * SUMMARY_MAX_CHUNKS
+
+class Generation;
+
+/** Stats and the best individual of one generation */
+struct GenerationSummary
+{
+  size_t index = 0;
+  double bestFitness = 0;
+  double averageFitness = 0;
+  float mutationRate = 0;
+  float crossoverRate = 0;
+  std::vector<size_t> bestIndividual;
+};
+
+/** Keeps summary of every generation, but whole populations only for the last HISTORY_RETENTION generations
+    and for every HISTORY_STRIDE-th generation, so the history grows by O(N) per generation.
+    Summaries are published lock-free: a summary is immutable once published and its memory never moves,
+    so size() and getSummary() can be called from any thread while the solver pushes, without locks and copies.
+    Everything else has to be synchronised by the owner */
+class GenerationHistory
+{
+public:
+  GenerationHistory(size_t retention = HISTORY_RETENTION, size_t stride = HISTORY_STRIDE);
+
+  ~GenerationHistory();
+
+  GenerationHistory(const GenerationHistory &) = delete;
+  GenerationHistory & operator=(const GenerationHistory &) = delete;
+
+  /** Sets how many whole generations are kept, has to be called before the first push */
+  void setLimits(size_t retention, size_t stride);
+
+  /** Adds generation to the history */
+  void push(Generation & generation);
+
+  /** Adds summary of a generation whose population is gone (e.g. the history of a resumed run), the summary's
+      index is replaced by the next one and its generation is kept only as the best individual */
+  void pushSummary(const GenerationSummary & summary);
+
+  /** Returns number of published generations (lock-free) */
+  size_t size(void) const;
+
+  /** Returns summary of the Nth generation, the reference stays valid for the lifetime of the history (lock-free) */
+  const GenerationSummary & getSummary(size_t N) const;
+
+  /** Returns true if the whole population of the Nth generation is kept */
+  bool isRetained(size_t N) const;
+
+  /** Returns the Nth generation, if its population is not kept, returned generation holds only its best individual
+      (with the stats of the whole generation) */
+  Generation getGeneration(size_t N) const;
+
+private:
+  struct Chunk
+  {
+    GenerationSummary summaries[SUMMARY_CHUNK_SIZE];
+  };
+
+  /** Returns unpublished slot of the next summary, allocates its chunk if needed */
+  GenerationSummary & nextSummary(void);
+
+  /** Keeps the whole generation if it is one of the recent or the sampled ones */
+  void retain(Generation & generation, size_t index);
+
+  size_t m_retention;
+  size_t m_stride;
+  // Directory of summary chunks, chunk pointer is published before the size that makes its summaries visible
+  std::unique_ptr<std::atomic<Chunk *>[]> m_chunks;
+  std::atomic<size_t> m_size {0};
+  // Ring buffer of the last m_retention generations, generation N is on index N % m_retention
+  std::vector<Generation> m_recent;
+  // Generation N * m_stride is on index N
+  std::vector<Generation> m_sampled;
+};
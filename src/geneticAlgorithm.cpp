@@ -6,17 +6,128 @@
 */
 
 #include "geneticAlgorithm.hpp"
+#include "conflictCounter.hpp"
+#include "permutation.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <cfloat>
 #include <algorithm>
-#include <random>
 #include <iostream>
 #include <cmath>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+
+/** Throws std::invalid_argument if the parameters can not be used */
+void GeneticConfig::validate(void) const
+{
+  if (previousGenCount == 0 || tournamentSize == 0)
+    throw std::invalid_argument("Elite count and tournament size must be positive");
+
+  if (2 * previousGenCount + 2 * (previousGenCrossoverCount / 2) > populationSize)
+    throw std::invalid_argument("Elites and their crossovers do not fit into the population");
+
+  if (mutationRate < 0 || mutationRate > 1 || crossoverRate < 0 || crossoverRate > 1)
+    throw std::invalid_argument("Rates must be in range [0, 1]");
+
+  if (permutationMutations < 0)
+    throw std::invalid_argument("Number of permutation mutations must not be negative");
+
+  if ((fitnessCacheSize & (fitnessCacheSize - 1)) != 0)
+    throw std::invalid_argument("Size of the fitness cache must be a power of two");
+
+  if (rejectDuplicates && fitnessCacheSize == 0)
+    throw std::invalid_argument("Duplicates are found by the fitness cache, its size must be positive to reject them");
+}
+
+namespace
+{
+  /** Parses the whole value of a parameter, throws std::invalid_argument if it is not a valid value */
+  template <typename T>
+  T parseParameter(const std::string & key, const std::string & value)
+  {
+    T result;
+    std::istringstream parse(value);
+    if (!(parse >> result) || !(parse >> std::ws).eof())
+      throw std::invalid_argument("Invalid value of " + key + ": " + value);
+
+    return result;
+  }
+}
+
+/** Sets the parameter by its name (e.g. "mutation-rate"), returns false if there is no such parameter */
+bool GeneticConfig::set(const std::string & key, const std::string & value)
+{
+  if (key == "population")
+    populationSize = parseParameter<size_t>(key, value);
+  else if (key == "generations")
+    generations = parseParameter<size_t>(key, value);
+  else if (key == "mutation-rate")
+    mutationRate = parseParameter<float>(key, value);
+  else if (key == "crossover-rate")
+    crossoverRate = parseParameter<float>(key, value);
+  else if (key == "elites")
+    previousGenCount = parseParameter<size_t>(key, value);
+  else if (key == "elite-crossover")
+    previousGenCrossoverCount = parseParameter<size_t>(key, value);
+  else if (key == "tournament")
+    tournamentSize = parseParameter<size_t>(key, value);
+  else if (key == "permutation-mutations")
+    permutationMutations = parseParameter<float>(key, value);
+  else if (key == "local-search-steps")
+    localSearchSteps = parseParameter<size_t>(key, value);
+  else if (key == "fitness-cache")
+    fitnessCacheSize = parseParameter<size_t>(key, value);
+  else if (key == "reject-duplicates" && (value == "true" || value == "false"))
+    rejectDuplicates = value == "true";
+  else if (key == "encoding" && (value == "columns" || value == "permutation"))
+    encoding = value == "columns" ? Encoding::Columns : Encoding::Permutation;
+  else if (key == "permutation-crossover" && (value == "pmx" || value == "ox" || value == "cycle"))
+    permutationCrossover = value == "pmx" ? PermutationCrossover::PMX
+                         : value == "ox" ? PermutationCrossover::OX : PermutationCrossover::Cycle;
+  else if (key == "permutation-mutation" && (value == "swap" || value == "inversion"))
+    permutationMutation = value == "swap" ? PermutationMutation::Swap : PermutationMutation::Inversion;
+  else if (key == "encoding" || key == "permutation-crossover" || key == "permutation-mutation" || key == "reject-duplicates")
+    throw std::invalid_argument("Invalid value of " + key + ": " + value);
+  else
+    return false;
+
+  return true;
+}
+
+/** Reads "key = value" lines (# starts a comment) from the file, throws std::invalid_argument on an error */
+void GeneticConfig::load(const std::string & path)
+{
+  std::ifstream file(path);
+  if (!file)
+    throw std::invalid_argument("Can not open config file " + path);
+
+  std::string line;
+  for (size_t lineNumber = 1; std::getline(file, line); lineNumber ++)
+  {
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    size_t separator = line.find('=');
+    std::istringstream parseKey(line.substr(0, separator));
+    std::string key;
+    parseKey >> key;
+
+    // Surrounding whitespace is not part of the value
+    std::string value = separator == std::string::npos ? "" : line.substr(separator + 1);
+    value.erase(0, value.find_first_not_of(" \t\r"));
+    value.erase(value.find_last_not_of(" \t\r") + 1);
+
+    if (separator == std::string::npos || !this -> set(key, value))
+      throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": unknown parameter " + key);
+  }
+}
 
 /* Implementation of Generation class*/
 
-/** Returns number of positions that queen can be attack from */
+/** Returns number of positions that queen can be attack from (O(N), kept as the reference definition of fitness) */
 size_t Generation::attackCount(size_t row, std::vector<size_t> & individual)
 {
   size_t attacks = 0;
@@ -41,79 +152,288 @@ size_t Generation::attackCount(size_t row, std::vector<size_t> & individual)
   return attacks;
 }
 
-/** Gets fitness score for individual. Works such that fitness 0 means that no queens attack each other and N means that N queens attack each   other */
+/** Gets fitness score for individual. Works such that fitness 0 means that no queens attack each other and N means that N queens attack each   other.
+    Score is the same as summing attackCount over all rows, but the pairs are counted from occupancy histograms in O(N) */
 double Generation::getFitness(std::vector<size_t> & individual)
 {
-  double fitness = 0;
-  for (size_t i = 0; i < individual.size(); i ++)
+  /* Kernel is picked when the board size changes, not for every individual */
+  static thread_local size_t dimension = 0;
+  static thread_local ConflictKernel kernel = genericConflicts;
+  if (individual.size() != dimension)
   {
-    fitness += this -> attackCount(i, individual);
+    dimension = individual.size();
+    kernel = selectConflictKernel(dimension);
   }
-  return fitness;
+
+  return kernel(individual);
 }
 
 
+/** Creates generation that holds only the best individual of the summarised generation and its stats */
+Generation::Generation(const GenerationSummary & summary)
+  : m_mutationRate(summary.mutationRate),
+    m_crossoverRate(summary.crossoverRate),
+    m_highestFitness(summary.bestFitness),
+    m_averageFitness(summary.averageFitness),
+    m_summaryOnly(true),
+    m_generationIndex(summary.index)
+{
+  if (!summary.bestIndividual.empty())
+    m_population.push(summary.bestIndividual, summary.bestFitness);
+}
+
+/** Returns index of the generation */
+size_t Generation::getIndex(void)
+{
+  return m_generationIndex;
+}
+
 /** Adds individual to the generation */
 void Generation::addIndividual(std::vector<size_t> individual)
 {
-  m_sorted = false;
-  m_individuals.push_back(std::make_pair(individual, this -> getFitness(individual)));
+  double fitness = this -> getFitness(individual);
+  this -> addIndividual(individual, fitness);
 }
 
+/** Adds individual whose fitness is already known (e.g. updated incrementally) to the generation */
+void Generation::addIndividual(const std::vector<size_t> & individual, double fitness)
+{
+  m_sortedCount = 0;
+  m_population.push(individual, fitness);
 
-/** Gets the average fitness */
-double Generation::fitnessAverage(void)
+  /* Stats follow the added individual, no rescan is needed */
+  if (m_statsValid)
+  {
+    m_fitnessSum += fitness;
+    m_averageFitness = m_fitnessSum / m_population.size();
+    if (fitness < m_highestFitness)
+    {
+      m_highestFitness = fitness;
+      m_bestIndex = m_population.size() - 1;
+    }
+  }
+}
+
+/** Makes the generation hold count individuals with N genes, slots are filled by setIndividual */
+void Generation::resize(size_t count, size_t N)
+{
+  if (m_population.size() == 0)
+    m_population.setDimension(N);
+  m_sortedCount = 0;
+  m_statsValid = false;
+  m_population.resize(count);
+}
+
+/** Replaces individual on the index (the generation has to be sorted again) */
+void Generation::replaceIndividual(size_t index, const std::vector<size_t> & individual, double fitness)
 {
-  double sum = 0.0f;
-  for (const auto & value: m_individuals)
+  double previous = m_population.getFitness(index);
+  m_sortedCount = 0;
+  m_population.setGenome(index, individual, fitness);
+
+  /* Replacing the best individual by a worse one needs a rescan, everything else is updated in place */
+  if (!m_statsValid || (index == m_bestIndex && fitness > previous))
   {
-    sum += value.second;
+    m_statsValid = false;
+    return;
   }
 
-  return m_individuals.size() != 0 ? sum/m_individuals.size() : DBL_MAX;
+  m_fitnessSum += fitness - previous;
+  m_averageFitness = m_fitnessSum / m_population.size();
+  if (fitness < m_highestFitness || (fitness == m_highestFitness && index < m_bestIndex))
+  {
+    m_highestFitness = fitness;
+    m_bestIndex = index;
+  }
 }
 
-/** Gets the best fitness (could be calculated continuouly i guess, but this will do for now */
-double Generation::fitnessBest(void)
+/** Stores individual into the slot, different slots can be set from different threads */
+void Generation::setIndividual(size_t index, const std::vector<size_t> & individual, double fitness)
+{
+  m_population.setGenome(index, individual, fitness);
+}
+
+/** Drops the cached stats and elites after slots were set by setIndividual */
+void Generation::invalidate(void)
+{
+  m_sortedCount = 0;
+  m_statsValid = false;
+}
+
+/** Reserves space for count individuals with N genes */
+void Generation::reserve(size_t count, size_t N)
+{
+  if (m_population.size() == 0)
+    m_population.setDimension(N);
+  m_population.reserve(count);
+}
+
+/** Returns number of individuals in the generation */
+size_t Generation::size(void)
+{
+  return m_population.size();
+}
+
+/** Returns individual on the index (individuals keep the order in which they were added) */
+std::vector<size_t> Generation::getIndividual(size_t index)
+{
+  return m_population.getGenome(index);
+}
+
+/** Copies individual on the index into the vector (reuses its memory) */
+void Generation::getIndividual(size_t index, std::vector<size_t> & individual)
+{
+  m_population.getGenome(index, individual);
+}
+
+/** Returns fitness of the individual on the index */
+double Generation::getIndividualFitness(size_t index)
+{
+  return m_population.getFitness(index);
+}
+
+/** Returns storage of the individuals */
+const Population & Generation::getPopulation(void)
 {
-  double best = DBL_MAX;
-  for (const auto & value: m_individuals)
+  return m_population;
+}
+
+
+/** Rescores every individual with the batch evaluator */
+void Generation::evaluate(ThreadPool * pool, FitnessIsa isa)
+{
+  m_sortedCount = 0;
+  m_statsValid = false;
+
+  const size_t blocks = (m_population.size() + EVALUATION_BLOCK - 1) / EVALUATION_BLOCK;
+  auto evaluateBlock = [&] (size_t block, size_t)
+  {
+    double fitness[EVALUATION_BLOCK];
+    size_t begin = block * EVALUATION_BLOCK;
+    size_t end = std::min(begin + EVALUATION_BLOCK, m_population.size());
+    evaluateConflicts(m_population, begin, end, fitness, isa);
+    for (size_t i = begin; i < end; i ++)
+      m_population.setFitness(i, fitness[i - begin]);
+  };
+
+  if (pool == nullptr)
   {
-    best = std::min(best, value.second);
+    for (size_t block = 0; block < blocks; block ++)
+      evaluateBlock(block, 0);
   }
+  else
+    pool -> parallelFor(blocks, evaluateBlock);
+}
 
-  return best;
+/** Recomputes the stats in one pass if slots were written since the last query */
+void Generation::updateStats(void)
+{
+  if (m_statsValid || m_summaryOnly)
+    return;
+
+  m_fitnessSum = 0.0f;
+  m_highestFitness = DBL_MAX;
+  m_bestIndex = 0;
+  const std::vector<double> & fitness = m_population.fitness();
+  for (size_t i = 0; i < fitness.size(); i ++)
+  {
+    m_fitnessSum += fitness[i];
+    if (fitness[i] < m_highestFitness)
+    {
+      m_highestFitness = fitness[i];
+      m_bestIndex = i;
+    }
+  }
+
+  m_averageFitness = fitness.empty() ? DBL_MAX : m_fitnessSum / fitness.size();
+  m_statsValid = true;
+}
+
+/** Gets the average fitness */
+double Generation::fitnessAverage(void)
+{
+  this -> updateStats();
+  return m_averageFitness;
+}
+
+/** Gets the best fitness */
+double Generation::fitnessBest(void)
+{
+  this -> updateStats();
+  return m_highestFitness;
+}
+
+/** Returns index of the individual with the best fitness (the first one if there are more) */
+size_t Generation::bestIndex(void)
+{
+  this -> updateStats();
+  return m_bestIndex;
 }
 
 
 /** Returns N best individuals from generation */
 std::vector<std::vector<size_t>> Generation::getNBest(size_t n)
+{
+  std::vector<std::vector<size_t>> returnVector;
+
+  for (size_t index: this -> getNBestIndices(n))
+  {
+    returnVector.push_back(m_population.getGenome(index));
+  }
+
+  return returnVector;
+}
+
+/** Returns indices of N best individuals from generation */
+std::vector<size_t> Generation::getNBestIndices(size_t n)
 {
   /* If n > size */
-  if (n > m_individuals.size())
+  if (n > m_population.size())
     return {};
 
-  std::vector<std::vector<size_t>> returnVector;
-  size_t i = 0;
-
-  if (!m_sorted)
+  if (n > m_sortedCount)
   {
-    /* Sorted in ascending order (the lower the fitness, the better) */
-    std::sort(m_individuals.begin(), m_individuals.end(),
-              [] (const std::pair<std::vector<size_t>, double> & a, const std::pair<std::vector<size_t>, double> & b)
+    /* Select the indices instead of the individuals, so the index of an individual stays valid.
+       Only the first n are ordered (ascending, the lower the fitness, the better), ties by index so the
+       selection does not depend on the algorithm */
+    if (m_sortedCount == 0)
     {
-      return a.second < b.second;
+      m_order.resize(m_population.size());
+      for (size_t i = 0; i < m_order.size(); i ++)
+        m_order[i] = i;
+    }
+
+    const std::vector<double> & fitness = m_population.fitness();
+    std::partial_sort(m_order.begin(), m_order.begin() + n, m_order.end(),
+                      [&fitness] (size_t a, size_t b)
+    {
+      return fitness[a] < fitness[b] || (fitness[a] == fitness[b] && a < b);
     });
 
-    m_sorted = true;
+    m_sortedCount = n;
   }
 
-  for (size_t i = 0; i < n; i++)
+  return std::vector<size_t>(m_order.begin(), m_order.begin() + n);
+}
+
+/** Returns indices of N worst individuals from generation, the worst first */
+std::vector<size_t> Generation::getNWorstIndices(size_t n) const
+{
+  if (n > m_population.size())
+    return {};
+
+  std::vector<size_t> order(m_population.size());
+  for (size_t i = 0; i < order.size(); i ++)
+    order[i] = i;
+
+  const std::vector<double> & fitness = m_population.fitness();
+  std::partial_sort(order.begin(), order.begin() + n, order.end(), [&fitness] (size_t a, size_t b)
   {
-    returnVector.push_back(m_individuals[i].first);
-  }
+    return fitness[a] > fitness[b] || (fitness[a] == fitness[b] && a < b);
+  });
 
-  return returnVector;
+  order.resize(n);
+  return order;
 }
 
 
@@ -131,150 +451,627 @@ float Generation::getCrossoverRate(void)
 }
 
 
-/** Find n random individuals and returns the one with the best fitness */
-std::vector<size_t> Generation::getRandomTournament(size_t n)
+/** Find n random individuals (drawn from the given generator) and returns the one with the best fitness */
+std::vector<size_t> Generation::getRandomTournament(size_t n, Random & random)
 {
-  if (m_individuals.size() == 0)
+  if (m_population.size() == 0)
     return {};
 
-  std::random_device rd;
-  std::minstd_rand gen(rd());
-  std::uniform_int_distribution<int> dist(0, m_individuals.size() - 1);
+  return m_population.getGenome(this -> getRandomTournamentIndex(n, random));
+}
+
+/** Find n random individuals (drawn from the given generator) and returns index of the one with the best fitness */
+size_t Generation::getRandomTournamentIndex(size_t n, Random & random)
+{
+  const std::vector<double> & fitness = m_population.fitness();
 
-  Individual individual = m_individuals[dist(gen)];
-  for (int i = 1; i < n; i ++)
+  size_t best = random.bounded(fitness.size());
+  for (size_t i = 1; i < n; i ++)
   {
-    individual = std::min(individual, m_individuals[dist(gen)],
-                          [] (Individual x, Individual y)
-    {
-      return x.second < y.second;
-    });
+    size_t candidate = random.bounded(fitness.size());
+    if (fitness[candidate] < fitness[best])
+      best = candidate;
   }
 
-  return individual.first;
+  return best;
 }
 
 /** Generate individual (random position of queens on chess board) */
 std::vector<size_t> Genetic::generateIndividual()
 {
-  std::random_device rd;
-  std::minstd_rand gen(rd());
-  std::uniform_int_distribution<int> dist(0, m_dimension - 1);
-
   std::vector<size_t> individual;
+  this -> generateIndividual(individual, m_random);
+  return individual;
+}
 
-  for (size_t i = 0; i < m_dimension; i++)
+/** Generate individual into the vector using the given generator */
+void Genetic::generateIndividual(std::vector<size_t> & individual, Random & random)
+{
+  if (m_config.encoding == Encoding::Permutation)
   {
-    individual.emplace_back(dist(gen));
+    randomPermutation(individual, m_dimension, random);
+    return;
   }
 
-  return individual;
+  individual.resize(m_dimension);
+  for (size_t i = 0; i < m_dimension; i++)
+  {
+    individual[i] = random.bounded(m_dimension);
+  }
 }
 
 /** Crossover two individuals (combines their genes) with CROSSOVER_RATE probablity */
 std::pair<std::vector<size_t>, std::vector<size_t>> Genetic::crossoverIndividuals(std::vector<size_t> individual1, std::vector<size_t> individual2)
 {
   std::pair<std::vector<size_t>, std::vector<size_t>> newIndividuals;
-  std::vector<size_t> newIndividual;
+  std::pair<ConflictCounter, ConflictCounter> newCounters;
+  this -> crossoverIndividuals(individual1, ConflictCounter(individual1), individual2, ConflictCounter(individual2),
+                               newIndividuals, newCounters, m_random);
+  return newIndividuals;
+}
+
 
-  // Calculates the probability
-  std::random_device rd;
-  std::minstd_rand gen(rd());
-  std::uniform_int_distribution<int> dist(0, 100);
+/** Mutate individual with MUTATION_RATE probability. Each gene mutates with the probability, if mutation should happen
+    generate gene in range [0, m_dimension - 1], else keep the gene. Instead of a draw for every gene, the gap to the next
+    mutated gene is drawn from the geometric distribution                                                              */
+std::vector<size_t> Genetic::mutateIndividual(std::vector<size_t> individual)
+{
+  ConflictCounter counter(individual);
+  this -> mutateIndividual(individual, counter, m_random);
+  return individual;
+}
 
+/** Crossover two individuals and update the children conflict counters from the parent ones instead of rescoring them */
+void Genetic::crossoverIndividuals(const std::vector<size_t> & individual1, const ConflictCounter & counter1,
+                                   const std::vector<size_t> & individual2, const ConflictCounter & counter2,
+                                   std::pair<std::vector<size_t>, std::vector<size_t>> & children,
+                                   std::pair<ConflictCounter, ConflictCounter> & childrenCounters, Random & random)
+{
   // If crossover is not happening
-  if (dist(gen) > m_crossoverRate * 100)
+  if (!random.bernoulli(m_crossoverRate))
+  {
+    children.first = individual1;
+    children.second = individual2;
+    childrenCounters.first = counter1;
+    childrenCounters.second = counter2;
+    return;
+  }
+
+  if (m_config.encoding == Encoding::Permutation)
   {
-    newIndividuals.first = individual1;
-    newIndividuals.second = individual2;
-    return newIndividuals;
+    this -> permutationCrossover(individual1, individual2, children, childrenCounters, random);
+    return;
   }
 
   // Choose random point in m_dimension range to start the crossover
-  dist = std::uniform_int_distribution<int>(0, m_dimension - 1);
-  int crossoverStart = dist(gen);
+  size_t crossoverStart = random.bounded(m_dimension);
 
-  /* First crossover */
+  /* First child gets the prefix of the first individual, the second child the prefix of the second individual */
+  this -> spliceIndividuals(individual1, counter1, individual2, counter2, crossoverStart, children.first, childrenCounters.first);
+  this -> spliceIndividuals(individual2, counter2, individual1, counter1, crossoverStart, children.second, childrenCounters.second);
+}
 
-  // Get genes from the first individual
-  for (int i = 0; i < crossoverStart; i ++)
+/** Crossover of the permutation encoding, children are rescored because their genes move between positions */
+void Genetic::permutationCrossover(const std::vector<size_t> & individual1, const std::vector<size_t> & individual2,
+                                   std::pair<std::vector<size_t>, std::vector<size_t>> & children,
+                                   std::pair<ConflictCounter, ConflictCounter> & childrenCounters, Random & random)
+{
+  // Segment [begin, end) is never empty
+  size_t begin = random.bounded(m_dimension);
+  size_t end = random.bounded(m_dimension);
+  if (begin > end)
+    std::swap(begin, end);
+  end ++;
+
+  switch (m_config.permutationCrossover)
   {
-    newIndividual.push_back(individual1[i]);
+    case PermutationCrossover::PMX:
+      pmxCrossover(individual1, individual2, begin, end, children.first, children.second);
+      break;
+    case PermutationCrossover::OX:
+      oxCrossover(individual1, individual2, begin, end, children.first, children.second);
+      break;
+    case PermutationCrossover::Cycle:
+      cycleCrossover(individual1, individual2, children.first, children.second);
+      break;
   }
 
-  // Get genes from the second individual
-  for (int i = crossoverStart; i < m_dimension; i++)
+  childrenCounters.first.assign(children.first, this -> hashesGenomes());
+  childrenCounters.second.assign(children.second, this -> hashesGenomes());
+}
+
+/** Child gets genes [0, point) from prefixParent and [point, N) from suffixParent, counter is updated from the cheaper side */
+void Genetic::spliceIndividuals(const std::vector<size_t> & prefixParent, const ConflictCounter & prefixCounter,
+                                const std::vector<size_t> & suffixParent, const ConflictCounter & suffixCounter,
+                                size_t point, std::vector<size_t> & child, ConflictCounter & childCounter)
+{
+  /* Start from the parent that contributes more genes, so only min(point, N - point) queens have to be moved */
+  if (point < m_dimension - point)
   {
-    newIndividual.push_back(individual2[i]);
-  }
+    child = suffixParent;
+    childCounter = suffixCounter;
+    for (size_t i = 0; i < point; i ++)
+    {
+      if (child[i] == prefixParent[i])
+        continue;
 
-  newIndividuals.first = newIndividual;
+      childCounter.removeQueen(i, child[i]);
+      childCounter.addQueen(i, prefixParent[i]);
+      child[i] = prefixParent[i];
+    }
+  }
+  else
+  {
+    child = prefixParent;
+    childCounter = prefixCounter;
+    for (size_t i = point; i < m_dimension; i ++)
+    {
+      if (child[i] == suffixParent[i])
+        continue;
 
-  /* Second crossover */
-  newIndividual.clear();
+      childCounter.removeQueen(i, child[i]);
+      childCounter.addQueen(i, suffixParent[i]);
+      child[i] = suffixParent[i];
+    }
+  }
+}
 
-  // Get genes from the second individual
-  for (int i = 0; i < crossoverStart; i ++)
+/** Mutate individual in place with MUTATION_RATE probability and update its conflict counter for every changed gene */
+void Genetic::mutateIndividual(std::vector<size_t> & individual, ConflictCounter & counter, Random & random)
+{
+  // Jump straight to the genes that mutate (see mutateIndividual above)
+  const float rate = this -> geneMutationRate();
+  for (size_t i = random.geometric(rate); i < m_dimension; i += 1 + random.geometric(rate))
   {
-    newIndividual.push_back(individual1[i]);
+    /* Permutation stays a permutation, the mutated gene trades places with another one */
+    if (m_config.encoding == Encoding::Permutation)
+    {
+      this -> permutationMutation(individual, counter, i, random.bounded(m_dimension));
+      continue;
+    }
+
+    // Mutate the gene, only the moved queen changes the conflicts
+    size_t gene = random.bounded(m_dimension);
+    counter.removeQueen(i, individual[i]);
+    counter.addQueen(i, gene);
+    individual[i] = gene;
   }
+}
 
-  // Get genes from the first individual
-  for (int i = crossoverStart; i < m_dimension; i++)
+/** Min-conflicts local search, returns number of moves */
+size_t Genetic::localSearch(std::vector<size_t> & individual, ConflictCounter & counter, Random & random, size_t steps)
+{
+  // Rows that had a conflict when the list was built, a row is checked again when it is drawn
+  static thread_local std::vector<size_t> conflicted;
+  conflicted.clear();
+
+  size_t moves = 0;
+  while (moves < steps && counter.conflicts() != 0)
   {
-    newIndividual.push_back(individual2[i]);
-  }
+    if (conflicted.empty())
+    {
+      for (size_t row = 0; row < m_dimension; row ++)
+      {
+        // The queen itself is on its three lines
+        if (counter.attacks(row, individual[row]) > 3)
+          conflicted.push_back(row);
+      }
+    }
 
-  newIndividuals.second = newIndividual;
+    size_t pick = random.bounded(conflicted.size());
+    size_t row = conflicted[pick];
+    conflicted[pick] = conflicted.back();
+    conflicted.pop_back();
+    if (counter.attacks(row, individual[row]) == 3)
+      continue;
 
-  return newIndividuals;
-}
+    moves ++;
+    size_t best = row;
+    size_t ties = 0;
 
+    /* Queen moves to the column with the fewest queens on its lines, the current column is one of the candidates */
+    if (m_config.encoding == Encoding::Columns)
+    {
+      counter.removeQueen(row, individual[row]);
+      size_t fewest = SIZE_MAX;
+      for (size_t column = 0; column < m_dimension; column ++)
+      {
+        size_t attacks = counter.attacks(row, column);
+        if (attacks < fewest)
+        {
+          fewest = attacks;
+          best = column;
+          ties = 1;
+        }
+        else if (attacks == fewest && random.bounded(++ ties) == 0)
+          best = column;
+      }
+
+      counter.addQueen(row, best);
+      individual[row] = best;
+      continue;
+    }
 
-/** Mutate individual with MUTATION_RATE probability. For each gene calculate probability of mutation, if mutation should happen
-    generate gene in range [0, m_dimension - 1], else keep the gene                                                             */
-std::vector<size_t> Genetic::mutateIndividual(std::vector<size_t> individual)
+    /* Permutation stays a permutation, the row swaps its queen with the row that gives the fewest conflicts
+       (the row itself stands for no swap), every swap is tried and undone on the counter */
+    size_t fewest = counter.conflicts();
+    ties = 1;
+    for (size_t other = 0; other < m_dimension; other ++)
+    {
+      if (other == row)
+        continue;
+
+      counter.removeQueen(row, individual[row]);
+      counter.removeQueen(other, individual[other]);
+      counter.addQueen(row, individual[other]);
+      counter.addQueen(other, individual[row]);
+      size_t conflicts = counter.conflicts();
+      counter.removeQueen(row, individual[other]);
+      counter.removeQueen(other, individual[row]);
+      counter.addQueen(row, individual[row]);
+      counter.addQueen(other, individual[other]);
+
+      if (conflicts < fewest)
+      {
+        fewest = conflicts;
+        best = other;
+        ties = 1;
+      }
+      else if (conflicts == fewest && random.bounded(++ ties) == 0)
+        best = other;
+    }
+
+    // The scored move is a swap whatever mutation the encoding uses (an inversion would move the whole segment)
+    if (best != row)
+    {
+      counter.removeQueen(row, individual[row]);
+      counter.removeQueen(best, individual[best]);
+      std::swap(individual[row], individual[best]);
+      counter.addQueen(row, individual[row]);
+      counter.addQueen(best, individual[best]);
+    }
+  }
+
+  return moves;
+}
+
+/** Refines the elites of the current generation by the local search (in parallel) */
+void Genetic::refineElites(size_t index)
 {
-  std::vector<size_t> newIndividual;
+  if (m_config.localSearchSteps == 0)
+    return;
 
-  // Calculates the probability for each gene
-  std::random_device rd;
-  std::minstd_rand gen(rd());
-  std::uniform_int_distribution<int> distProba(0, 100);
-  std::uniform_int_distribution<int> distGene(0, m_dimension - 1);
+  /* Elites are refined in their slots, every elite has its own random stream and scratch genome */
+  std::vector<size_t> best;
+  {
+    PhaseTimer timer(m_profile, Phase::Sorting);
+    best = m_currentGen.getNBestIndices(std::min(m_config.previousGenCount, m_currentGen.size()));
+  }
 
-  for (size_t i = 0; i < m_dimension; i ++)
+  PhaseTimer timer(m_profile, Phase::LocalSearch, true, best.size());
+  m_pool -> parallelFor(best.size(), [&] (size_t task, size_t worker)
   {
-    // Keep the gene same
-    if (distProba(gen) > m_mutationRate * 100)
-    {
-      newIndividual.push_back(individual[i]);
-    }
+    Random random = Random::derive(m_seed, index, LOCAL_SEARCH_TASK_OFFSET + task);
+    std::vector<size_t> & individual = m_scratches[worker].child;
+    m_currentGen.getIndividual(best[task], individual);
+    this -> localSearch(individual, m_prevCounters[best[task]], random, m_config.localSearchSteps);
+    m_currentGen.setIndividual(best[task], individual, m_prevCounters[best[task]].conflicts());
+    m_scratches[worker].profile.add(Phase::Random, 0, random.draws());
+  });
+  this -> collectProfiles(0);
+
+  m_currentGen.invalidate();
+}
 
-    // Mutate the gene
-    else
+/** Records the current generation in the fitness cache in slot order. Children keep the hash of their genome in their
+    counters, so a lookup is O(1). Children's fitness is already updated from the parents' counters, the cache tells
+    which genomes were seen before: hits are genomes of earlier generations (e.g. elites that did not mutate),
+    duplicates are copies of an individual that is earlier in the same generation. Duplicates are mutated again if
+    they are rejected, the first copy is kept, so elites survive */
+void Genetic::filterDuplicates(size_t index)
+{
+  if (m_cache.size() == 0)
+    return;
+
+  PhaseTimer timer(m_profile, Phase::Duplicates, true, m_currentGen.size());
+  bool changed = false;
+  for (size_t i = 0; i < m_currentGen.size(); i ++)
+  {
+    ConflictCounter & counter = m_prevCounters[i];
+    CacheLookup result = m_cache.visit(counter.hash(), counter.conflicts(), index);
+    if (result != CacheLookup::Duplicate || !m_config.rejectDuplicates || m_dimension < 2)
+      continue;
+
+    Random random = Random::derive(m_seed, index, DUPLICATE_TASK_OFFSET + i);
+    std::vector<size_t> & individual = m_scratches[0].child;
+    m_currentGen.getIndividual(i, individual);
+    for (size_t retry = 0; retry < DUPLICATE_RETRIES && result == CacheLookup::Duplicate; retry ++)
     {
-      newIndividual.push_back(distGene(gen));
+      this -> forceMutation(individual, counter, random);
+      result = m_cache.visit(counter.hash(), counter.conflicts(), index);
     }
+
+    m_cache.countRejected();
+    m_currentGen.setIndividual(i, individual, counter.conflicts());
+    changed = true;
+  }
+
+  if (changed)
+    m_currentGen.invalidate();
+}
+
+/** Moves one queen to another column (swaps two queens in the permutation encoding), the genome always changes */
+void Genetic::forceMutation(std::vector<size_t> & individual, ConflictCounter & counter, Random & random)
+{
+  size_t row = random.bounded(m_dimension);
+
+  // Second draw skips the current value, so it is always different
+  if (m_config.encoding == Encoding::Permutation)
+  {
+    size_t other = random.bounded(m_dimension - 1);
+    this -> permutationMutation(individual, counter, row, other + (other >= row));
+    return;
+  }
+
+  size_t column = random.bounded(m_dimension - 1);
+  column += column >= individual[row];
+  counter.removeQueen(row, individual[row]);
+  counter.addQueen(row, column);
+  individual[row] = column;
+}
+
+/** Creates the worker pool, the scratches and the cache of the run */
+void Genetic::prepare(void)
+{
+  /* Workers breed the generation in parallel, every worker has its own scratch genomes */
+  m_pool = std::make_unique<ThreadPool>(m_threads);
+  m_scratches.resize(m_pool -> size());
+  m_cache = FitnessCache(m_config.fitnessCacheSize);
+}
+
+/** Returns true if the counters keep the hashes of the genomes, only the fitness cache looks at them */
+bool Genetic::hashesGenomes(void) const
+{
+  // Config is checked instead of the cache, which is created only when the run starts
+  return m_config.fitnessCacheSize != 0;
+}
+
+/** Returns number of individuals of every generation after the first one */
+size_t Genetic::generationSize(void)
+{
+  const size_t crossoverPairs = m_config.previousGenCrossoverCount / 2;
+  const size_t tournamentPairs = m_config.populationSize - 2 * m_config.previousGenCount - 2 * crossoverPairs;
+  return m_config.previousGenCount + 2 * crossoverPairs + 2 * tournamentPairs;
+}
+
+/** Returns probability that a gene mutates in the current generation. Every mutation of the permutation encoding moves
+    at least two queens, so its rate is scaled to permutationMutations moves per individual (whatever the board size)
+    and follows the annealing of the mutation rate */
+float Genetic::geneMutationRate(void)
+{
+  if (m_config.encoding == Encoding::Columns)
+    return m_mutationRate;
+
+  float annealing = m_config.mutationRate > 0 ? m_mutationRate / m_config.mutationRate : 0;
+  return std::min(1.0f, m_config.permutationMutations / m_dimension) * annealing;
+}
+
+/** Swaps genes first and second, or reverses the genes between them, and updates the counter for the moved queens */
+void Genetic::permutationMutation(std::vector<size_t> & individual, ConflictCounter & counter, size_t first, size_t second)
+{
+  if (first == second)
+    return;
+  if (first > second)
+    std::swap(first, second);
+
+  if (m_config.permutationMutation == PermutationMutation::Swap)
+  {
+    counter.removeQueen(first, individual[first]);
+    counter.removeQueen(second, individual[second]);
+    std::swap(individual[first], individual[second]);
+    counter.addQueen(first, individual[first]);
+    counter.addQueen(second, individual[second]);
+    return;
   }
 
-  return newIndividual;
+  /* Inversion moves every queen of the segment */
+  for (size_t i = first; i <= second; i ++)
+    counter.removeQueen(i, individual[i]);
+
+  std::reverse(individual.begin() + first, individual.begin() + second + 1);
+
+  for (size_t i = first; i <= second; i ++)
+    counter.addQueen(i, individual[i]);
 }
 
 /** Returns Nth generation */
 Generation Genetic::getNthGeneration(size_t N)
 {
   std::unique_lock<std::mutex> lock (m_mtx);
-  if (N >= m_generations.size())
-    throw std::out_of_range("Generation Out of range");
+  return m_generations.getGeneration(N);
+}
+
+/** Returns stats and the best individual of the Nth generation */
+const GenerationSummary & Genetic::getNthSummary(size_t N)
+{
+  /* Published summaries never change, so the renderer reads them without locking the solver */
+  return m_generations.getSummary(N);
+}
+
+/** Sets how many whole generations the history keeps, has to be called before the run */
+void Genetic::setHistoryLimits(size_t retention, size_t stride)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_generations.setLimits(retention, stride);
+}
+
+/** Streams every generation into the log (nullptr stops it), has to be called before the run */
+void Genetic::setRunLog(RunLogWriter * log)
+{
+  m_runLog = log;
+
+  /* Resumed run already has generations, its log starts with the current one */
+  if (m_runLog != nullptr && this -> getGenerationsCount() != 0)
+  {
+    m_runLog -> begin(m_dimension, std::max(m_config.populationSize, this -> generationSize()), m_seed);
+    m_runLog -> append(m_currentGen);
+  }
+}
+
+/** Writes the state of the run between two steps into the checkpoint */
+void Genetic::saveState(CheckpointBuffer & buffer)
+{
+  buffer.put<uint64_t>(m_dimension);
+  buffer.put<uint64_t>(m_seed);
+
+  /* Schedule, generator and cache, the breeding streams are derived from the seed and the generation index */
+  uint64_t state[4];
+  m_random.getState(state);
+  buffer.put<uint64_t>(m_generationIndex);
+  buffer.put(m_mutationRate);
+  buffer.put(m_crossoverRate);
+  buffer.put<uint8_t>(m_finished);
+  buffer.put<uint64_t>(m_evaluations);
+  buffer.put(state);
+  m_cache.save(buffer);
+
+  /* Genes of the current generation, fitness and counters are rebuilt from them */
+  const Population & population = m_currentGen.getPopulation();
+  buffer.put<uint64_t>(m_currentGen.getIndex());
+  buffer.put(m_currentGen.getMutationRate());
+  buffer.put(m_currentGen.getCrossoverRate());
+  buffer.put<uint32_t>(population.geneWidth());
+  buffer.put<uint64_t>(population.size());
+  if (population.size() != 0)
+  {
+    population.visitGenes(0, [&] (const auto * genes)
+    {
+      buffer.putBytes(genes, population.size() * m_dimension * sizeof(*genes));
+    });
+  }
+
+  /* Stats of the history, the best individual only of the last generation (whole history would be O(N) per generation) */
+  const size_t count = m_generations.size();
+  buffer.put<uint64_t>(count);
+  for (size_t i = 0; i < count; i ++)
+  {
+    const GenerationSummary & summary = m_generations.getSummary(i);
+    buffer.put(summary.bestFitness);
+    buffer.put(summary.averageFitness);
+    buffer.put(summary.mutationRate);
+    buffer.put(summary.crossoverRate);
+    buffer.put(m_generationCounters[i]);
+  }
+
+  const std::vector<size_t> & best = m_generations.getSummary(count - 1).bestIndividual;
+  buffer.put<uint64_t>(best.size());
+  buffer.putBytes(best.data(), best.size() * sizeof(size_t));
+}
+
+/** Restores the state written by saveState instead of initialize */
+void Genetic::restoreState(CheckpointReader & reader)
+{
+  if (this -> getGenerationsCount() != 0)
+    throw std::logic_error("State can be restored only before the run");
+  if (reader.get<uint64_t>() != m_dimension || reader.get<uint64_t>() != m_seed)
+    throw std::runtime_error("Checkpoint " + reader.path() + " belongs to another run");
+
+  this -> prepare();
+
+  uint64_t state[4];
+  m_generationIndex = reader.get<uint64_t>();
+  m_mutationRate = reader.get<float>();
+  m_crossoverRate = reader.get<float>();
+  m_finished = reader.get<uint8_t>();
+  m_evaluations = reader.get<uint64_t>();
+  reader.getBytes(state, sizeof(state));
+  m_random.setState(state);
+  m_cache.restore(reader);
+
+  size_t index = reader.get<uint64_t>();
+  float mutationRate = reader.get<float>();
+  float crossoverRate = reader.get<float>();
+  size_t geneWidth = reader.get<uint32_t>();
+  size_t size = reader.get<uint64_t>();
+  if (geneWidth != Population(m_dimension).geneWidth())
+    throw std::runtime_error("Checkpoint " + reader.path() + " has genes of another width");
+  // First generation has populationSize individuals, the following ones generationSize()
+  if (size == 0 || size != (index == 0 ? m_config.populationSize : this -> generationSize())
+      || m_dimension > reader.remaining() / geneWidth / size)
+    throw std::runtime_error("Checkpoint " + reader.path() + " has an invalid population size");
+
+  std::vector<unsigned char> genes(size * m_dimension * geneWidth);
+  reader.getBytes(genes.data(), genes.size());
+
+  /* Counters are rebuilt from the genes, so the children of the next step inherit the same counts */
+  m_currentGen = Generation(index, mutationRate, crossoverRate);
+  m_currentGen.resize(size, m_dimension);
+  m_prevCounters.resize(size);
+  std::vector<size_t> individual(m_dimension);
+  for (size_t i = 0; i < size; i ++)
+  {
+    for (size_t gene = 0; gene < m_dimension; gene ++)
+    {
+      const unsigned char * bytes = genes.data() + (i * m_dimension + gene) * geneWidth;
+      if (geneWidth == 1)
+        individual[gene] = *bytes;
+      else if (geneWidth == 2)
+      {
+        uint16_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        individual[gene] = value;
+      }
+      else
+      {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        individual[gene] = value;
+      }
+
+      // Counter indexes its histograms by the genes, a corrupt gene would write out of them
+      if (individual[gene] >= m_dimension)
+        throw std::runtime_error("Checkpoint " + reader.path() + " has a gene out of the board");
+    }
 
-  return m_generations[N];
+    m_prevCounters[i].assign(individual, this -> hashesGenomes());
+    m_currentGen.setIndividual(i, individual, m_prevCounters[i].conflicts());
+  }
+
+  /* Every saved run has at least its first generation, the count is checked against the remaining bytes before
+     the summaries are allocated */
+  const size_t count = reader.get<uint64_t>();
+  const size_t summaryBytes = 2 * sizeof(double) + 2 * sizeof(float) + sizeof(RunCounters);
+  if (count == 0 || count != index + 1 || count != m_generationIndex || count > reader.remaining() / summaryBytes)
+    throw std::runtime_error("Checkpoint " + reader.path() + " has an invalid history");
+
+  std::vector<GenerationSummary> summaries(count);
+  std::vector<RunCounters> counters(count);
+  for (size_t i = 0; i < count; i ++)
+  {
+    summaries[i].bestFitness = reader.get<double>();
+    summaries[i].averageFitness = reader.get<double>();
+    summaries[i].mutationRate = reader.get<float>();
+    summaries[i].crossoverRate = reader.get<float>();
+    counters[i] = reader.get<RunCounters>();
+  }
+
+  std::vector<size_t> & best = summaries.back().bestIndividual;
+  best.resize(reader.get<uint64_t>());
+  if (best.size() != m_dimension)
+    throw std::runtime_error("Checkpoint " + reader.path() + " has an invalid best individual");
+  reader.getBytes(best.data(), best.size() * sizeof(size_t));
+  if (std::any_of(best.begin(), best.end(), [this] (size_t gene) { return gene >= m_dimension; }))
+    throw std::runtime_error("Checkpoint " + reader.path() + " has a gene out of the board");
+
+  std::unique_lock<std::mutex> lock (m_mtx);
+  for (const GenerationSummary & summary: summaries)
+    m_generations.pushSummary(summary);
+  m_generationCounters = std::move(counters);
 }
 
 /** Returns number of generations */
 size_t Genetic::getGenerationsCount(void)
 {
-  std::unique_lock<std::mutex> lock (m_mtx);
   return m_generations.size();
 }
 
@@ -286,77 +1083,393 @@ bool Genetic::isFinished()
 }
 
 
-/** Runs the whole genetic algorithm */
-bool Genetic::run(void)
+/** Returns seed of the run */
+uint64_t Genetic::getSeed(void)
 {
-  /* Randomly generate the first generation */
-  Generation gen(m_generationIndex ++, MUTATION_RATE, CROSSOVER_RATE);
-  for (size_t i = 0; i < POPULATION_SIZE; i ++)
-  {
-    gen.addIndividual(this -> generateIndividual());
-  }
+  return m_seed;
+}
+
+/** Returns number of worker threads */
+size_t Genetic::getThreadCount(void)
+{
+  return m_threads;
+}
+
+/** Returns parameters of the algorithm */
+const GeneticConfig & Genetic::getConfig(void)
+{
+  return m_config;
+}
+
+/** Returns number of individuals whose fitness was evaluated */
+size_t Genetic::getEvaluationsCount(void)
+{
+  return m_evaluations;
+}
 
+/** Returns number of individuals evaluated in the first generations generations */
+size_t Genetic::getEvaluationsCount(size_t generations)
+{
   std::unique_lock<std::mutex> lock (m_mtx);
-  m_generations.push_back(gen);
-  lock.unlock();
+  if (generations == 0 || m_generationCounters.empty())
+    return 0;
 
-  for (size_t i = 1; i < GENERATIONS; i ++)
-  {
-    /* Use simulated annealing to update mutation and crossover rates */
-    m_mutationRate = MUTATION_RATE * std::exp(-static_cast<float>(i) / GENERATIONS);
-    m_crossoverRate = CROSSOVER_RATE * std::exp(-static_cast<float>(i) / GENERATIONS * 1.0);
+  return m_generationCounters[std::min(generations, m_generationCounters.size()) - 1].evaluations;
+}
 
-    lock.lock();
-    Generation prevGen = m_generations[m_generationIndex - 1];
-    /* If previous generation has low fitness, make crossover rate lower and mutation rate higher */
-    lock.unlock();
+/** Returns counters of the fitness cache */
+FitnessCacheStats Genetic::getCacheStats(void)
+{
+  return m_cache.stats();
+}
 
-    Generation newGen(m_generationIndex ++, m_mutationRate, m_crossoverRate);
-    /* Add the best N individuals from the previous generation, but mutate their genes */
-    for (auto & individual: prevGen.getNBest(PREVIOUS_GEN_COUNT))
-    {
-      newGen.addIndividual(this -> mutateIndividual(individual));
-    }
+/** Returns counters of the fitness cache after the first generations generations */
+FitnessCacheStats Genetic::getCacheStats(size_t generations)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  if (generations == 0 || m_generationCounters.empty())
+    return FitnessCacheStats();
 
-    /* Crossover the best N individuals from the previous generation and mutate their genes */
-    std::random_device rd;
-    std::minstd_rand gen(rd());
-    std::uniform_int_distribution<int> dist(0, PREVIOUS_GEN_COUNT - 1);
+  return m_generationCounters[std::min(generations, m_generationCounters.size()) - 1].cache;
+}
 
-    std::vector<std::vector<size_t>> individuals = prevGen.getNBest(PREVIOUS_GEN_COUNT);
-    std::pair<std::vector<size_t>, std::vector<size_t>> newIndividuals;
+/** Returns time and calls of the phases of the Nth generation */
+PhaseProfile Genetic::getProfile(size_t N)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  return N < m_profiles.size() ? m_profiles[N] : PhaseProfile();
+}
+
+/** Returns number of generations with a profile */
+size_t Genetic::getProfilesCount(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  return m_profiles.size();
+}
 
+/** Returns sum of the profiles of all generations */
+PhaseProfile Genetic::getProfileTotal(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  return m_profileTotal;
+}
 
+/** Adds the worker profiles to the profile of the generation. Only every PROFILE_SAMPLE_INTERVAL-th task times its
+    breeding phases, so their time is scaled by the share of the timed tasks */
+void Genetic::collectProfiles(size_t tasks)
+{
+  if constexpr (!NQUEENS_PROFILE)
+    return;
 
-    for (int j = 0; j < PREVIOUS_GEN_CROSSOVER_COUNT / 2; j++)
+  const size_t timedTasks = (tasks + PROFILE_SAMPLE_INTERVAL - 1) / PROFILE_SAMPLE_INTERVAL;
+  const double scale = timedTasks == 0 ? 1.0 : static_cast<double>(tasks) / timedTasks;
+  for (BreedScratch & scratch: m_scratches)
+  {
+    for (Phase phase: {Phase::Selection, Phase::Crossover, Phase::Mutation, Phase::Evaluation})
     {
-      newIndividuals = this -> crossoverIndividuals(individuals[dist(gen)], individuals[dist(gen)]);
-      newGen.addIndividual(this -> mutateIndividual(newIndividuals.first));
-      newGen.addIndividual(this -> mutateIndividual(newIndividuals.second));
+      uint64_t & time = scratch.profile.nanoseconds[static_cast<size_t>(phase)];
+      time = static_cast<uint64_t>(time * scale);
     }
 
+    m_profile += scratch.profile;
+    scratch.profile.clear();
+  }
+}
 
-    // Add the rest of the individuals to the population using Tournament method
-    for (int j = 0; j < (POPULATION_SIZE - 2 * PREVIOUS_GEN_COUNT - 2 * (PREVIOUS_GEN_CROSSOVER_COUNT / 2)); j ++)
+/** Publishes the profile of the generation, has to be called with m_mtx locked */
+void Genetic::publishProfile(size_t index, uint64_t start)
+{
+  if constexpr (!NQUEENS_PROFILE)
+    return;
+
+  m_profile.generation = index;
+  m_profile.add(Phase::Total, profileNow() - start);
+  m_profiles.push_back(m_profile);
+  m_profileTotal += m_profile;
+  m_profile.clear();
+}
+
+/** Breeds one task of the generation into its slots of newGen and newCounters. Tasks are the mutated elites,
+    the crossed elite pairs and the tournament pairs, every task has its own random stream and its own slots,
+    so tasks can run on any worker in any order without locks and the result is the same.
+    Calls of the phases are counted in every task, their time only in every PROFILE_SAMPLE_INTERVAL-th one */
+void Genetic::breedTask(size_t task, BreedScratch & scratch, Random & random, Generation & prevGen,
+                        const std::vector<ConflictCounter> & prevCounters, const std::vector<size_t> & best,
+                        Generation & newGen, std::vector<ConflictCounter> & newCounters)
+{
+  const size_t crossoverPairs = m_config.previousGenCrossoverCount / 2;
+  const bool timed = task % PROFILE_SAMPLE_INTERVAL == 0;
+
+  /* Add the best N individuals from the previous generation, but mutate their genes */
+  if (task < best.size())
+  {
+    ConflictCounter & counter = newCounters[task];
     {
-      newIndividuals = this -> crossoverIndividuals(prevGen.getRandomTournament(TOURNAMENT_SIZE), prevGen.getRandomTournament(TOURNAMENT_SIZE));
-      newGen.addIndividual(this -> mutateIndividual(newIndividuals.first));
-      newGen.addIndividual(this -> mutateIndividual(newIndividuals.second));
+      PhaseTimer timer(scratch.profile, Phase::Selection, timed);
+      prevGen.getIndividual(best[task], scratch.child);
+      // Counters are assigned (not copied into new objects), so their histograms keep their memory between generations
+      counter = prevCounters[best[task]];
+    }
+    {
+      PhaseTimer timer(scratch.profile, Phase::Mutation, timed);
+      this -> mutateIndividual(scratch.child, counter, random);
     }
 
-    lock.lock();
-    m_generations.push_back(newGen);
-    lock.unlock();
-    //std::cout << "Generation: " << m_generationIndex << ", Average: " << newGen.fitnessAverage() << ", Best: " << newGen.fitnessBest()  << std::endl;
+    PhaseTimer timer(scratch.profile, Phase::Evaluation, timed);
+    newGen.setIndividual(task, scratch.child, counter.conflicts());
+    return;
+  }
+
+  size_t parent1;
+  size_t parent2;
+  size_t pair = task - best.size();
+
+  {
+    PhaseTimer timer(scratch.profile, Phase::Selection, timed, 2);
 
-    if (newGen.fitnessBest() == 0.0f)
+    /* Crossover the best N individuals from the previous generation */
+    if (pair < crossoverPairs)
     {
-      m_finished = true;
-      std::cout << "Success" << std::endl;
-      return true;
+      parent1 = best[random.bounded(best.size())];
+      parent2 = best[random.bounded(best.size())];
     }
+    // The rest of the individuals is added using Tournament method
+    else
+    {
+      parent1 = prevGen.getRandomTournamentIndex(m_config.tournamentSize, random);
+      parent2 = prevGen.getRandomTournamentIndex(m_config.tournamentSize, random);
+    }
+
+    prevGen.getIndividual(parent1, scratch.parent1);
+    prevGen.getIndividual(parent2, scratch.parent2);
+  }
+  {
+    PhaseTimer timer(scratch.profile, Phase::Crossover, timed);
+    this -> crossoverIndividuals(scratch.parent1, prevCounters[parent1], scratch.parent2, prevCounters[parent2],
+                                 scratch.children, scratch.childrenCounters, random);
+  }
+
+  /* Mutate the children genes */
+  {
+    PhaseTimer timer(scratch.profile, Phase::Mutation, timed, 2);
+    this -> mutateIndividual(scratch.children.first, scratch.childrenCounters.first, random);
+    this -> mutateIndividual(scratch.children.second, scratch.childrenCounters.second, random);
+  }
+
+  size_t slot = best.size() + 2 * pair;
+  PhaseTimer timer(scratch.profile, Phase::Evaluation, timed, 2);
+  newCounters[slot] = scratch.childrenCounters.first;
+  newGen.setIndividual(slot, scratch.children.first, scratch.childrenCounters.first.conflicts());
+  newCounters[slot + 1] = scratch.childrenCounters.second;
+  newGen.setIndividual(slot + 1, scratch.children.second, scratch.childrenCounters.second.conflicts());
+}
+
+/** Creates the worker pool and randomly generates the first generation */
+void Genetic::initialize(void)
+{
+  const uint64_t start = profileNow();
+  this -> prepare();
+
+  m_currentGen = Generation(m_generationIndex ++, m_config.mutationRate, m_config.crossoverRate);
+  m_currentGen.resize(m_config.populationSize, m_dimension);
+  m_prevCounters.resize(m_config.populationSize);
+  m_evaluations += m_config.populationSize;
+  m_pool -> parallelFor(m_config.populationSize, [&] (size_t task, size_t worker)
+  {
+    Random random = Random::derive(m_seed, 0, task);
+    BreedScratch & scratch = m_scratches[worker];
+    this -> generateIndividual(scratch.child, random);
+
+    PhaseTimer timer(scratch.profile, Phase::Evaluation, task % PROFILE_SAMPLE_INTERVAL == 0);
+    m_prevCounters[task].assign(scratch.child, this -> hashesGenomes());
+    m_currentGen.setIndividual(task, scratch.child, m_prevCounters[task].conflicts());
+    scratch.profile.add(Phase::Random, 0, random.draws());
+  });
+  this -> collectProfiles(m_config.populationSize);
+
+  this -> refineElites(0);
+  this -> filterDuplicates(0);
+
+  /* Log is written by its own thread, append only copies the generation */
+  if (m_runLog != nullptr)
+  {
+    m_runLog -> begin(m_dimension, std::max(m_config.populationSize, this -> generationSize()), m_seed);
+    m_runLog -> append(m_currentGen);
+  }
+
+  std::unique_lock<std::mutex> lock (m_mtx, std::defer_lock);
+  {
+    PhaseTimer timer(m_profile, Phase::LockWait);
+    lock.lock();
+  }
+  {
+    PhaseTimer timer(m_profile, Phase::HistoryPush);
+    m_generations.push(m_currentGen);
+  }
+  m_generationCounters.push_back({m_evaluations, m_cache.stats()});
+  m_finished = m_currentGen.fitnessBest() == 0.0f;
+  this -> publishProfile(0, start);
+}
+
+/** Breeds the next generation from the current one, returns true if it contains a solution */
+bool Genetic::step(void)
+{
+  /* Every following generation has the same size: mutated elites, crossed elites and tournament children */
+  const size_t crossoverPairs = m_config.previousGenCrossoverCount / 2;
+  const size_t tournamentPairs = m_config.populationSize - 2 * m_config.previousGenCount - 2 * crossoverPairs;
+  const size_t generationSize = this -> generationSize();
+  const size_t index = m_generationIndex ++;
+  const uint64_t start = profileNow();
+
+  /* Use simulated annealing to update mutation and crossover rates */
+  m_mutationRate = m_config.mutationRate * std::exp(-static_cast<float>(index) / m_config.generations);
+  m_crossoverRate = m_config.crossoverRate * std::exp(-static_cast<float>(index) / m_config.generations * 1.0);
+
+  Generation newGen(index, m_mutationRate, m_crossoverRate);
+  newGen.resize(generationSize, m_dimension);
+  m_newCounters.resize(generationSize);
+
+  /* Elites are selected before the workers start, the previous generation is only read from then on */
+  std::vector<size_t> best;
+  {
+    PhaseTimer timer(m_profile, Phase::Sorting);
+    best = m_currentGen.getNBestIndices(m_config.previousGenCount);
+  }
+  m_evaluations += generationSize;
+
+  const size_t tasks = best.size() + crossoverPairs + tournamentPairs;
+  m_pool -> parallelFor(tasks, [&] (size_t task, size_t worker)
+  {
+    Random random = Random::derive(m_seed, index, task);
+    this -> breedTask(task, m_scratches[worker], random, m_currentGen, m_prevCounters, best, newGen, m_newCounters);
+    m_scratches[worker].profile.add(Phase::Random, 0, random.draws());
+  });
+  this -> collectProfiles(tasks);
+
+  /* The new generation becomes the parent generation, counters are swapped to reuse their memory */
+  m_currentGen = std::move(newGen);
+  std::swap(m_prevCounters, m_newCounters);
+
+  this -> refineElites(index);
+  this -> filterDuplicates(index);
+
+  if (m_runLog != nullptr)
+    m_runLog -> append(m_currentGen);
+
+  /* Readers (e.g. the visualisation) hold the lock too, the time spent waiting for it is measured apart from the push */
+  std::unique_lock<std::mutex> lock (m_mtx, std::defer_lock);
+  {
+    PhaseTimer timer(m_profile, Phase::LockWait);
+    lock.lock();
+  }
+  {
+    PhaseTimer timer(m_profile, Phase::HistoryPush);
+    m_generations.push(m_currentGen);
+  }
+  m_generationCounters.push_back({m_evaluations, m_cache.stats()});
+  m_finished = m_currentGen.fitnessBest() == 0.0f;
+  this -> publishProfile(index, start);
+  //std::cout << "Generation: " << m_generationIndex << ", Average: " << m_currentGen.fitnessAverage() << ", Best: " << m_currentGen.fitnessBest()  << std::endl;
+
+  return m_finished;
+}
+
+/** Returns true if another generation can be bred (no solution yet and GENERATIONS not reached) */
+bool Genetic::hasNextGeneration(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  return !m_finished && m_generationIndex < m_config.generations && !m_stopSource.stop_requested();
+}
+
+/** Returns token that is signalled when the run is asked to stop */
+std::stop_token Genetic::getStopToken(void)
+{
+  return m_stopSource.get_token();
+}
+
+/** Asks the run to stop at the next generation boundary (a paused run stops too) */
+void Genetic::requestStop(void)
+{
+  // Wakes the paused thread through the token
+  m_stopSource.request_stop();
+}
+
+/** Pauses the run at the next generation boundary */
+void Genetic::pause(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_paused = true;
+}
+
+/** Resumes a paused run */
+void Genetic::resume(void)
+{
+  {
+    std::unique_lock<std::mutex> lock (m_mtx);
+    m_paused = false;
+  }
+  m_resumed.notify_all();
+}
+
+/** Returns true if the run is paused (or will pause at the next generation boundary) */
+bool Genetic::isPaused(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  return m_paused;
+}
+
+/** Waits while the run is paused, returns false if the run should stop */
+bool Genetic::waitWhilePaused(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_resumed.wait(lock, m_stopSource.get_token(), [this] ()
+  {
+    return !m_paused;
+  });
+
+  return !m_stopSource.stop_requested();
+}
+
+/** Returns copies of the count best individuals of the current generation */
+std::vector<std::vector<size_t>> Genetic::getMigrants(size_t count)
+{
+  return m_currentGen.getNBest(std::min(count, m_currentGen.size()));
+}
+
+/** Replaces the worst individuals of the current generation by the migrants */
+void Genetic::acceptMigrants(const std::vector<std::vector<size_t>> & migrants)
+{
+  std::vector<size_t> worst = m_currentGen.getNWorstIndices(std::min(migrants.size(), m_currentGen.size()));
+  PhaseTimer timer(m_profile, Phase::Evaluation, true, worst.size());
+  for (size_t i = 0; i < worst.size(); i ++)
+  {
+    m_prevCounters[worst[i]].assign(migrants[i], this -> hashesGenomes());
+    m_currentGen.replaceIndividual(worst[i], migrants[i], m_prevCounters[worst[i]].conflicts());
+  }
+}
+
+/** Rescores the current generation from its genes with the batch evaluator, returns its best fitness */
+double Genetic::evaluateGeneration(void)
+{
+  PhaseTimer timer(m_profile, Phase::Evaluation, true, m_currentGen.size());
+  m_currentGen.evaluate(m_pool.get());
+  m_evaluations += m_currentGen.size();
+  return m_currentGen.fitnessBest();
+}
+
+/** Runs the whole genetic algorithm */
+bool Genetic::run(void)
+{
+  // Restored run continues from its checkpoint
+  if (this -> getGenerationsCount() == 0)
+    this -> initialize();
+
+  while (this -> waitWhilePaused() && this -> hasNextGeneration())
+  {
+    this -> step();
   }
 
-  std::cout << "Failure" << std::endl;
-  return false;
+  bool success = this -> isFinished();
+  std::cout << (success ? "Success" : "Failure") << std::endl;
+  return success;
 }
@@ -7,12 +7,30 @@
 
 #pragma once
 
+#include "conflictCounter.hpp"
+#include "random.hpp"
+#include "population.hpp"
+#include "threadPool.hpp"
+#include "generationHistory.hpp"
+#include "fixedKernels.hpp"
+#include "batchFitness.hpp"
+#include "runLog.hpp"
+#include "fitnessCache.hpp"
+#include "profiler.hpp"
+#include "checkpoint.hpp"
+
 #include <vector>
+#include <string>
 #include <map>
 #include <cstddef>
 #include <mutex>
+#include <condition_variable>
+#include <stop_token>
 #include <atomic>
-#include <mutex>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <cfloat>
 
 #define POPULATION_SIZE 500 // Population might be +- 1 than POPULATION_SIZE due to crossover, but that is not a problem
 #define GENERATIONS 10000
@@ -21,6 +39,63 @@
 #define PREVIOUS_GEN_COUNT 25 // Needs to be lower than population_size
 #define PREVIOUS_GEN_CROSSOVER_COUNT 125 // Needs to be lower than population_size
 #define TOURNAMENT_SIZE 10
+#define EVALUATION_BLOCK 64 // Number of individuals scored by one task of the batch evaluator
+#define PERMUTATION_MUTATIONS 1.0f // Expected number of swaps (inversions) of one individual in the permutation encoding
+#define LOCAL_SEARCH_STEPS 0 // Min-conflicts steps of every elite in every generation (0 turns the local search off)
+#define LOCAL_SEARCH_TASK_OFFSET (1ull << 32) // Random streams of the local search follow the ones of the breeding tasks
+#define REJECT_DUPLICATES false // Mutate children that are copies of another individual of their generation
+#define DUPLICATE_RETRIES 4 // Extra mutations of a duplicate before it is kept anyway
+#define DUPLICATE_TASK_OFFSET (2ull << 32) // Random streams of the duplicate mutations follow the ones of the local search
+
+/** Representation of the individuals, gene i is the column of the queen in row i in both */
+enum class Encoding
+{
+  Columns, // Any column for every queen, queens can share a column
+  Permutation // Every column is used exactly once, only diagonal conflicts are possible
+};
+
+/** Crossover of the permutation encoding */
+enum class PermutationCrossover
+{
+  PMX, // Partially mapped crossover
+  OX, // Order crossover
+  Cycle // Cycle crossover
+};
+
+/** Mutation of the permutation encoding, both keep the individual a permutation */
+enum class PermutationMutation
+{
+  Swap, // Swaps two genes
+  Inversion // Reverses the genes between two positions
+};
+
+/** Parameters of the genetic algorithm, defaults are the values above */
+struct GeneticConfig
+{
+  Encoding encoding = Encoding::Columns;
+  PermutationCrossover permutationCrossover = PermutationCrossover::PMX;
+  PermutationMutation permutationMutation = PermutationMutation::Swap;
+  size_t populationSize = POPULATION_SIZE;
+  size_t generations = GENERATIONS;
+  float crossoverRate = CROSSOVER_RATE;
+  float mutationRate = MUTATION_RATE;
+  size_t previousGenCount = PREVIOUS_GEN_COUNT;
+  size_t previousGenCrossoverCount = PREVIOUS_GEN_CROSSOVER_COUNT;
+  size_t tournamentSize = TOURNAMENT_SIZE;
+  float permutationMutations = PERMUTATION_MUTATIONS;
+  size_t localSearchSteps = LOCAL_SEARCH_STEPS;
+  size_t fitnessCacheSize = FITNESS_CACHE_SIZE;
+  bool rejectDuplicates = REJECT_DUPLICATES;
+
+  /** Throws std::invalid_argument if the parameters can not be used */
+  void validate(void) const;
+
+  /** Sets the parameter by its name (e.g. "mutation-rate"), returns false if there is no such parameter */
+  bool set(const std::string & key, const std::string & value);
+
+  /** Reads "key = value" lines (# starts a comment) from the file, throws std::invalid_argument on an error */
+  void load(const std::string & path);
+};
 
 using Individual = std::pair<std::vector<size_t>, double>;
 
@@ -34,45 +109,113 @@ public:
       m_crossoverRate(crossoverRate)
   {};
 
+  /** Creates generation that holds only the best individual of the summarised generation and its stats */
+  explicit Generation(const GenerationSummary & summary);
+
+  /** Returns index of the generation */
+  size_t getIndex(void);
+
   /** Returns number of positions that queen can be attack from */
   size_t attackCount(size_t row, std::vector<size_t> & individual);
 
-  /** Gets fitness  for individual */
+  /** Gets fitness  for individual (uses the kernel specialised for its board size, if there is one) */
   double getFitness(std::vector<size_t> & individual);
 
   /** Adds individual to the generation */
   void addIndividual(std::vector<size_t> individual);
 
-  /** Gets the average fitness */
+  /** Adds individual whose fitness is already known (e.g. updated incrementally) to the generation */
+  void addIndividual(const std::vector<size_t> & individual, double fitness);
+
+  /** Reserves space for count individuals with N genes */
+  void reserve(size_t count, size_t N);
+
+  /** Makes the generation hold count individuals with N genes, slots are filled by setIndividual */
+  void resize(size_t count, size_t N);
+
+  /** Stores individual into the slot, different slots can be set from different threads.
+      Stats and elites of a resized generation are recomputed on the next query, slots must not be set while they
+      are queried and invalidate has to be called if they were queried before */
+  void setIndividual(size_t index, const std::vector<size_t> & individual, double fitness);
+
+  /** Drops the cached stats and elites after slots were set by setIndividual */
+  void invalidate(void);
+
+  /** Replaces individual on the index (the generation has to be sorted again) */
+  void replaceIndividual(size_t index, const std::vector<size_t> & individual, double fitness);
+
+  /** Returns number of individuals in the generation */
+  size_t size(void);
+
+  /** Returns individual on the index (individuals keep the order in which they were added) */
+  std::vector<size_t> getIndividual(size_t index);
+
+  /** Copies individual on the index into the vector (reuses its memory) */
+  void getIndividual(size_t index, std::vector<size_t> & individual);
+
+  /** Returns fitness of the individual on the index */
+  double getIndividualFitness(size_t index);
+
+  /** Returns storage of the individuals */
+  const Population & getPopulation(void);
+
+  /** Rescores every individual with the batch evaluator (blocks of EVALUATION_BLOCK individuals run on the pool if
+      there is one), the scores are the same as the ones of getFitness */
+  void evaluate(ThreadPool * pool = nullptr, FitnessIsa isa = detectFitnessIsa());
+
+  /** Gets the average fitness (O(1), maintained by addIndividual, one pass after the slots were set) */
   double fitnessAverage(void);
 
-  /** Gets the best fitness (could be calculated continuouly i guess, but this will do for now */
+  /** Gets the best fitness (O(1), maintained like the average) */
   double fitnessBest(void);
 
+  /** Returns index of the individual with the best fitness (the first one if there are more) */
+  size_t bestIndex(void);
+
   /** Returns N best individuals from generation */
   std::vector<std::vector<size_t>> getNBest(size_t n);
 
+  /** Returns indices of N best individuals from generation (ties are ordered by index), O(P log N) partial selection
+      that is reused until the generation changes */
+  std::vector<size_t> getNBestIndices(size_t n);
+
+  /** Returns indices of N worst individuals from generation, the worst first (ties by index), O(P log N) */
+  std::vector<size_t> getNWorstIndices(size_t n) const;
+
   /** Returns generations mutation rate */
   float getMutationRate(void);
 
   /** Returns generations crossover rate */
   float getCrossoverRate(void);
 
-  /** Finds n random individuals and returns the one with the highest fitness */
-  std::vector<size_t> getRandomTournament(size_t n);
+  /** Finds n random individuals (drawn from the given generator) and returns the one with the highest fitness */
+  std::vector<size_t> getRandomTournament(size_t n, Random & random);
+
+  /** Finds n random individuals (drawn from the given generator) and returns index of the one with the highest fitness */
+  size_t getRandomTournamentIndex(size_t n, Random & random);
 
 
 private:
-  /* Represents position on chess board, such that each element in vector is a row, index
-    represents at which column the queen is, -1 represents that there is no queen in that row */
-  std::vector<std::pair<std::vector<size_t>, double>> m_individuals;
-  bool m_sorted = false;
+  /* Represents position on chess board, such that each gene is a row, value represents at which column the queen is.
+     All genomes are stored in one buffer and their fitness in a separate array */
+  Population m_population;
+  // Permutation of the individual indices, the first m_sortedCount are the best ones in order
+  std::vector<size_t> m_order;
+  size_t m_sortedCount = 0;
   float m_mutationRate;
   float m_crossoverRate;
 
-  // not using for now, can be used later for better performance
-  double m_highestFitness;
-  double m_averageFitness;
+  /** Recomputes the stats in one pass if slots were written since the last query */
+  void updateStats(void);
+
+  // Best (lowest) and average fitness, valid if m_statsValid is true
+  double m_highestFitness = DBL_MAX;
+  double m_averageFitness = DBL_MAX;
+  double m_fitnessSum = 0;
+  size_t m_bestIndex = 0;
+  bool m_statsValid = true;
+  // Generation restored from a summary reports the average of the original population
+  bool m_summaryOnly = false;
 
   size_t m_generationIndex;
 };
@@ -84,40 +227,253 @@ class BoardVisualisation;
 class Genetic
 {
 public:
-  Genetic(size_t N)
-    : m_dimension(N)
-  {};
+  Genetic(size_t N, uint64_t seed = Random::randomSeed(), size_t threads = std::thread::hardware_concurrency(),
+          GeneticConfig config = GeneticConfig())
+    : m_dimension(N),
+      m_seed(seed),
+      m_threads(std::max<size_t>(threads, 1)),
+      m_config(config),
+      m_random(seed),
+      m_mutationRate(config.mutationRate),
+      m_crossoverRate(config.crossoverRate)
+  {
+    m_config.validate();
+  };
 
   /** Generate individual (random position of queens on chess board) */
   std::vector<size_t> generateIndividual();
 
-  /** Crossover two individuals (combines their genes) with CROSSOVER_RATE probability  */
+  /** Generate individual into the vector using the given generator */
+  void generateIndividual(std::vector<size_t> & individual, Random & random);
+
+  /** Crossover two individuals (combines their genes) with CROSSOVER_RATE probability, children get the prefix of one
+      parent and the suffix of the other (or the permutation crossover of the permutation encoding) */
   std::pair<std::vector<size_t>, std::vector<size_t>> crossoverIndividuals(std::vector<size_t> individual1, std::vector<size_t> individual2);
 
+  /** Crossover two individuals and update the children conflict counters from the parent ones instead of rescoring them
+      (permutation crossovers rescore the children) */
+  void crossoverIndividuals(const std::vector<size_t> & individual1, const ConflictCounter & counter1,
+                            const std::vector<size_t> & individual2, const ConflictCounter & counter2,
+                            std::pair<std::vector<size_t>, std::vector<size_t>> & children,
+                            std::pair<ConflictCounter, ConflictCounter> & childrenCounters, Random & random);
+
   /** Mutate individual with MUTATION_RATE probability */
   std::vector<size_t> mutateIndividual(std::vector<size_t> individual);
 
-  /** Returns Nth generation */
+  /** Mutate individual in place with MUTATION_RATE probability and update its conflict counter for every changed gene
+      (swap or inversion starting at every mutated gene in the permutation encoding) */
+  void mutateIndividual(std::vector<size_t> & individual, ConflictCounter & counter, Random & random);
+
+  /** Returns Nth generation (only its best individual if the population is no longer kept, see GenerationHistory) */
   Generation getNthGeneration(size_t N);
 
-  /** Returns current mutatio*/
+  /** Returns stats and the best individual of the Nth generation (lock-free, valid for the lifetime of Genetic) */
+  const GenerationSummary & getNthSummary(size_t N);
+
+  /** Sets how many whole generations the history keeps, has to be called before the run */
+  void setHistoryLimits(size_t retention, size_t stride);
+
+  /** Streams every generation into the log (nullptr stops it), has to be called before the run,
+      the log has to outlive the run. Log of a resumed run starts with its current generation */
+  void setRunLog(RunLogWriter * log);
+
+  /** Writes the state of the run between two steps into the checkpoint: the current generation, the schedule
+      (generation index and annealed rates), the generator, the fitness cache and the stats of the history.
+      Has to be called by the thread that runs the steps */
+  void saveState(CheckpointBuffer & buffer);
 
-  /** Returns number of generations */
+  /** Restores the state written by saveState instead of initialize, the following steps breed the same generations
+      as the saved run would have. Summaries of the restored history keep only their stats (and the best individual
+      of the last one). Throws std::runtime_error if the checkpoint was written for another board size or seed */
+  void restoreState(CheckpointReader & reader);
+
+  /** Returns seed of the run */
+  uint64_t getSeed(void);
+
+  /** Returns number of worker threads */
+  size_t getThreadCount(void);
+
+  /** Returns parameters of the algorithm */
+  const GeneticConfig & getConfig(void);
+
+  /** Returns number of individuals whose fitness was evaluated */
+  size_t getEvaluationsCount(void);
+
+  /** Returns number of individuals evaluated in the first generations generations (all of them if there are fewer) */
+  size_t getEvaluationsCount(size_t generations);
+
+  /** Returns counters of the fitness cache (read them when the run is not stepping) */
+  FitnessCacheStats getCacheStats(void);
+
+  /** Returns counters of the fitness cache after the first generations generations */
+  FitnessCacheStats getCacheStats(size_t generations);
+
+  /** Returns time and calls of the phases of the Nth generation (zeros if profiling is compiled out) */
+  PhaseProfile getProfile(size_t N);
+
+  /** Returns number of generations with a profile (0 if profiling is compiled out) */
+  size_t getProfilesCount(void);
+
+  /** Returns sum of the profiles of all generations */
+  PhaseProfile getProfileTotal(void);
+
+  /** Returns number of generations (lock-free) */
   size_t getGenerationsCount(void);
 
   /** Returns true if calculation is finished */
   bool isFinished();
 
+  /** Creates the worker pool and randomly generates the first generation */
+  void initialize(void);
+  /** Breeds the next generation from the current one, returns true if it contains a solution */
+  bool step(void);
+
+  /** Returns true if another generation can be bred (no solution yet, GENERATIONS not reached and no stop requested) */
+  bool hasNextGeneration(void);
+
+  /** Returns token that is signalled when the run is asked to stop */
+  std::stop_token getStopToken(void);
+
+  /** Asks the run to stop at the next generation boundary (a paused run stops too), can be called from any thread */
+  void requestStop(void);
+
+  /** Pauses the run at the next generation boundary, the paused thread sleeps until resume or requestStop */
+  void pause(void);
+
+  /** Resumes a paused run */
+  void resume(void);
+
+  /** Returns true if the run is paused (or will pause at the next generation boundary) */
+  bool isPaused(void);
+
+  /** Called by the running thread at generation boundaries, waits while the run is paused,
+      returns false if the run should stop */
+  bool waitWhilePaused(void);
+
+  /** Returns copies of the count best individuals of the current generation */
+  std::vector<std::vector<size_t>> getMigrants(size_t count);
+
+  /** Replaces the worst individuals of the current generation by the migrants */
+  void acceptMigrants(const std::vector<std::vector<size_t>> & migrants);
+
+  /** Rescores the current generation from its genes with the batch evaluator, returns its best fitness */
+  double evaluateGeneration(void);
+
+  /** Min-conflicts local search: moves the queen of a random conflicted row to the column that it attacks
+      the least from (swaps it with the row that removes the most conflicts in the permutation encoding), ties are
+      broken randomly, so sideways moves leave plateaus. Every move reads the counter in O(1) per candidate.
+      Runs until there are no conflicts or for at most steps moves, returns number of moves */
+  size_t localSearch(std::vector<size_t> & individual, ConflictCounter & counter, Random & random, size_t steps);
+
   /** Runs the whole genetic algorithm */
   bool run(void);
 
 
 private:
+  /** Working memory of one worker, reused for every child it breeds */
+  struct BreedScratch
+  {
+    std::vector<size_t> child;
+    std::vector<size_t> parent1;
+    std::vector<size_t> parent2;
+    std::pair<std::vector<size_t>, std::vector<size_t>> children;
+    std::pair<ConflictCounter, ConflictCounter> childrenCounters;
+    // Phases of the tasks run by the worker in the current step
+    PhaseProfile profile;
+  };
+
+  /** Breeds one task of the generation into its slots of newGen and newCounters */
+  void breedTask(size_t task, BreedScratch & scratch, Random & random, Generation & prevGen,
+                 const std::vector<ConflictCounter> & prevCounters, const std::vector<size_t> & best,
+                 Generation & newGen, std::vector<ConflictCounter> & newCounters);
+
+  /** Crossover of the permutation encoding, children are rescored because their genes move between positions */
+  void permutationCrossover(const std::vector<size_t> & individual1, const std::vector<size_t> & individual2,
+                            std::pair<std::vector<size_t>, std::vector<size_t>> & children,
+                            std::pair<ConflictCounter, ConflictCounter> & childrenCounters, Random & random);
+
+  /** Refines the elites of the current generation by the local search (in parallel), random streams of the
+      generation index keep the result independent of the thread count */
+  void refineElites(size_t index);
+
+  /** Records the current generation in the fitness cache in slot order, copies of an individual that is earlier in
+      the generation are mutated again if duplicates are rejected (own random streams, so threads do not matter) */
+  void filterDuplicates(size_t index);
+
+  /** Moves one queen to another column (swaps two queens in the permutation encoding), the genome always changes */
+  void forceMutation(std::vector<size_t> & individual, ConflictCounter & counter, Random & random);
+
+  /** Adds the worker profiles to the profile of the generation, time of the sampled breeding phases of tasks
+      tasks is scaled to all of them */
+  void collectProfiles(size_t tasks);
+
+  /** Publishes the profile of the generation, has to be called with m_mtx locked */
+  void publishProfile(size_t index, uint64_t start);
+
+  /** Creates the worker pool, the scratches and the cache of the run (initialize and restoreState) */
+  void prepare(void);
+
+  /** Returns true if the counters keep the hashes of the genomes, only the fitness cache looks at them */
+  bool hashesGenomes(void) const;
+
+  /** Returns number of individuals of every generation after the first one */
+  size_t generationSize(void);
+
+  /** Returns probability that a gene mutates in the current generation */
+  float geneMutationRate(void);
+
+  /** Swaps genes first and second, or reverses the genes between them, and updates the counter for the moved queens */
+  void permutationMutation(std::vector<size_t> & individual, ConflictCounter & counter, size_t first, size_t second);
+
+  /** Child gets genes [0, point) from prefixParent and [point, N) from suffixParent, counter is updated from the cheaper side */
+  void spliceIndividuals(const std::vector<size_t> & prefixParent, const ConflictCounter & prefixCounter,
+                         const std::vector<size_t> & suffixParent, const ConflictCounter & suffixCounter,
+                         size_t point, std::vector<size_t> & child, ConflictCounter & childCounter);
+
   size_t m_dimension;
+  uint64_t m_seed;
+  size_t m_threads;
+  GeneticConfig m_config;
+  // Random draws outside of run (which gives every task its own stream of the seed)
+  Random m_random;
   size_t m_generationIndex = 0;
-  float m_mutationRate = MUTATION_RATE;
-  float m_crossoverRate = CROSSOVER_RATE;
+  float m_mutationRate;
+  float m_crossoverRate;
   bool m_finished = false;
-  std::vector<Generation> m_generations;
+  std::atomic<size_t> m_evaluations {0};
+
+  /* State of the run between steps */
+  std::unique_ptr<ThreadPool> m_pool;
+  std::vector<BreedScratch> m_scratches;
+  Generation m_currentGen {0, 0, 0};
+  /* Conflict counters of the individuals in the current and in the new generation (same indices as in the generations),
+     children inherit them from their parents, so their fitness is updated only for the genes that changed */
+  std::vector<ConflictCounter> m_prevCounters;
+  std::vector<ConflictCounter> m_newCounters;
+  // Genomes of the recent generations, keyed on the hashes kept by the counters
+  FitnessCache m_cache;
+
+  GenerationHistory m_generations;
+  // Phases of the step being computed (migrants accepted before the step are counted in it)
+  PhaseProfile m_profile;
+  /** Counters of the run when a generation was published */
+  struct RunCounters
+  {
+    size_t evaluations;
+    FitnessCacheStats cache;
+  };
+
+  // Counters of the run up to every generation (including it), guarded by m_mtx
+  std::vector<RunCounters> m_generationCounters;
+  // Profiles of all generations and their sum, guarded by m_mtx
+  std::vector<PhaseProfile> m_profiles;
+  PhaseProfile m_profileTotal;
+  // Not owned, null if the run is not logged
+  RunLogWriter * m_runLog = nullptr;
   std::mutex m_mtx;
+
+  /* Cooperative control of the run, checked at generation boundaries */
+  std::stop_source m_stopSource;
+  bool m_paused = false;
+  std::condition_variable_any m_resumed;
 };
@@ -0,0 +1,414 @@
+/**
+ * @file islandModel.cpp
+ * @author Ondrej
+ * @brief Island model that runs several genetic algorithms in parallel and migrates individuals between them
+ *
+*/
+
+#include "islandModel.hpp"
+
+#include <iostream>
+#include <numeric>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+  const char CHECKPOINT_MAGIC[8] = {'N', 'Q', 'C', 'H', 'E', 'C', 'K', 'P'};
+}
+
+IslandModel::IslandModel(size_t N, uint64_t seed, size_t islands, size_t migrationInterval, size_t migrants,
+                         MigrationTopology topology, size_t threads, GeneticConfig config)
+  : m_dimension(N),
+    m_islandCount(std::clamp<size_t>(islands, 1, ISLAND_LIMIT)),
+    m_threads(threads),
+    m_config(config),
+    m_mailboxes(std::clamp<size_t>(islands, 1, ISLAND_LIMIT)),
+    m_seed(seed),
+    m_migrationInterval(std::max<size_t>(migrationInterval, 1)),
+    m_migrants(migrants),
+    m_topology(topology)
+{
+  this -> createIslands(seed);
+}
+
+/** Creates the islands of the seed */
+void IslandModel::createIslands(uint64_t seed)
+{
+  m_seed = seed;
+  m_solution = UINT64_MAX;
+  m_islands.clear();
+  m_snapshots.assign(m_islandCount, CheckpointBuffer());
+  m_snapshotGenerations.assign(m_islandCount, 0);
+
+  /* Threads are split between the islands, the first island keeps the seed so one island is the same as plain Genetic */
+  size_t islandThreads = std::max<size_t>(m_threads / m_islandCount, 1);
+  for (size_t i = 0; i < m_islandCount; i ++)
+  {
+    uint64_t islandSeed = i == 0 ? seed : Random::mix(seed + i);
+    m_islands.push_back(std::make_unique<Genetic>(m_dimension, islandSeed, islandThreads, m_config));
+  }
+}
+
+/** Creates model whose islands continue the run saved in the checkpoint */
+std::unique_ptr<IslandModel> IslandModel::fromCheckpoint(const std::string & path, size_t threads)
+{
+  CheckpointReader reader(path);
+  CheckpointHeader header = reader.get<CheckpointHeader>();
+  if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != CHECKPOINT_VERSION)
+    throw std::runtime_error(path + " is not a checkpoint");
+  if (header.configSize != sizeof(GeneticConfig))
+    throw std::runtime_error("Checkpoint " + path + " was written by another build");
+  // Every island takes more than one byte, so a corrupt count can not allocate more islands than the file has
+  if (header.dimension == 0 || header.islands == 0 || header.islands > reader.remaining() || header.islands > ISLAND_LIMIT
+      || header.topology > static_cast<uint64_t>(MigrationTopology::Random))
+    throw std::runtime_error("Checkpoint " + path + " has an invalid header");
+
+  /* Parameters of the run come from the checkpoint, islands are created with the same seeds and then restored */
+  GeneticConfig config = reader.get<GeneticConfig>();
+  if (config.encoding > Encoding::Permutation || config.permutationCrossover > PermutationCrossover::Cycle
+      || config.permutationMutation > PermutationMutation::Inversion)
+    throw std::runtime_error("Checkpoint " + path + " has invalid parameters");
+
+  try
+  {
+    config.validate();
+  }
+  catch (const std::invalid_argument & error)
+  {
+    throw std::runtime_error("Checkpoint " + path + " has invalid parameters: " + error.what());
+  }
+
+  auto model = std::make_unique<IslandModel>(header.dimension, header.seed, header.islands, header.migrationInterval,
+                                             header.migrants, static_cast<MigrationTopology>(header.topology),
+                                             threads, config);
+  for (auto & island: model -> m_islands)
+  {
+    island -> restoreState(reader);
+  }
+
+  if (!reader.atEnd())
+    throw std::runtime_error("Checkpoint " + path + " has more islands than its header");
+
+  return model;
+}
+
+/** Writes checkpoint of all islands into the writer every interval generations */
+void IslandModel::setCheckpoint(CheckpointWriter * writer, size_t interval)
+{
+  if (interval == 0 || (m_islands.size() > 1 && interval % m_migrationInterval != 0))
+    throw std::invalid_argument("Checkpoint interval has to be a positive multiple of the migration interval");
+
+  m_checkpoint = writer;
+  m_checkpointInterval = interval;
+}
+
+/** Runs all islands and prints the result, returns true if some island found a solution */
+bool IslandModel::run(void)
+{
+  bool success = this -> solve();
+  std::cout << (success ? "Success" : "Failure") << std::endl;
+  return success;
+}
+
+/** Runs all islands without printing, returns true if some island found a solution */
+bool IslandModel::solve(void)
+{
+  std::barrier<> barrier(m_islands.size());
+
+  /* The calling thread runs the first island */
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < m_islands.size(); i ++)
+  {
+    threads.emplace_back(&IslandModel::runIsland, this, i, std::ref(barrier));
+  }
+
+  this -> runIsland(0, barrier);
+
+  for (auto & thread: threads)
+  {
+    thread.join();
+  }
+
+  return this -> isFinished();
+}
+
+/** Evolves one island and takes part in the migrations */
+void IslandModel::runIsland(size_t island, std::barrier<> & barrier)
+{
+  Genetic & genetic = *m_islands[island];
+  // Island restored from a checkpoint already has its generations
+  if (genetic.getGenerationsCount() == 0)
+    genetic.initialize();
+
+  while (true)
+  {
+    const size_t generations = genetic.getGenerationsCount();
+    if (genetic.isFinished())
+    {
+      this -> claimSolution(island, generations);
+      break;
+    }
+
+    /* Islands run up to the generation of the earliest solution found so far, an island that is behind can still
+       find an earlier one, so the winner and the reported counts do not depend on the speed of the threads */
+    if (generations >= this -> getSolvedGenerations())
+      break;
+
+    if (!genetic.hasNextGeneration())
+      break;
+
+    // Stop request (or pause) is handled between generations, so the island stops within one generation
+    if (!genetic.waitWhilePaused())
+      break;
+
+    // Solution is claimed on the next pass, the island does not need migrants anymore
+    if (genetic.step())
+      continue;
+
+    /* Migrations and checkpoints follow the generation index, so a resumed island keeps the same schedule */
+    const size_t generation = genetic.getGenerationsCount() - 1;
+    const bool checkpoint = m_checkpoint != nullptr && generation % m_checkpointInterval == 0;
+    if (m_islands.size() > 1 && generation % m_migrationInterval == 0)
+    {
+      /* Every island posts its best individuals, waits until all of them did and takes migrants from its source.
+         Second barrier keeps the mailboxes untouched until everybody read them, islands are saved in between,
+         so the checkpoint holds all of them after the same migration */
+      m_mailboxes[island] = genetic.getMigrants(m_migrants);
+      barrier.arrive_and_wait();
+      genetic.acceptMigrants(m_mailboxes[this -> getSourceIsland(island, generation / m_migrationInterval)]);
+      if (checkpoint)
+        this -> snapshotIsland(island, generation);
+      barrier.arrive_and_wait();
+    }
+    else if (checkpoint)
+      this -> snapshotIsland(island, generation);
+
+    // Other islands save their next snapshot only after the next migration, which waits for this one
+    if (checkpoint && island == 0)
+      this -> submitCheckpoint(generation);
+  }
+
+  // Islands that are still running do not wait for this one anymore
+  barrier.arrive_and_drop();
+}
+
+/** Records the solution of the island unless another island solved the problem in fewer generations
+    (or in the same number with a lower index) */
+void IslandModel::claimSolution(size_t island, size_t generations)
+{
+  // Packed solutions compare by the generations first, then by the island
+  const uint64_t solution = (static_cast<uint64_t>(generations) << SOLVED_ISLAND_BITS) | island;
+  uint64_t current = m_solution.load(std::memory_order_acquire);
+  while (solution < current && !m_solution.compare_exchange_weak(current, solution, std::memory_order_acq_rel))
+  {
+  }
+}
+
+/** Returns generations of the solution, SIZE_MAX if there is none */
+size_t IslandModel::getSolvedGenerations(void)
+{
+  const uint64_t solution = m_solution.load(std::memory_order_acquire);
+  return solution == UINT64_MAX ? SIZE_MAX : solution >> SOLVED_ISLAND_BITS;
+}
+
+/** Saves state of the island after the generation into its snapshot */
+void IslandModel::snapshotIsland(size_t island, size_t generation)
+{
+  m_snapshots[island] = CheckpointBuffer();
+  m_islands[island] -> saveState(m_snapshots[island]);
+  m_snapshotGenerations[island] = generation;
+}
+
+/** Hands snapshots of all islands over to the checkpoint writer if all of them saved the generation */
+void IslandModel::submitCheckpoint(size_t generation)
+{
+  // Island that stopped (or found a solution) before the generation has an older snapshot
+  for (size_t saved: m_snapshotGenerations)
+  {
+    if (saved != generation)
+      return;
+  }
+
+  CheckpointHeader header = {};
+  std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.configSize = sizeof(GeneticConfig);
+  header.dimension = m_dimension;
+  header.seed = m_seed;
+  header.islands = m_islands.size();
+  header.migrationInterval = m_migrationInterval;
+  header.migrants = m_migrants;
+  header.topology = static_cast<uint64_t>(m_topology);
+  header.generation = generation;
+
+  /* Only the copy into one buffer is done here, the writer thread writes it to the disk */
+  CheckpointBuffer buffer;
+  buffer.put(header);
+  buffer.put(m_config);
+  for (const CheckpointBuffer & snapshot: m_snapshots)
+  {
+    buffer.putBytes(snapshot.bytes().data(), snapshot.bytes().size());
+  }
+
+  m_checkpoint -> submit(buffer.release());
+}
+
+/** Returns island whose migrants the island receives in the migration */
+size_t IslandModel::getSourceIsland(size_t island, size_t migration)
+{
+  size_t count = m_islands.size();
+  if (m_topology == MigrationTopology::Ring)
+    return (island + count - 1) % count;
+
+  /* Every island draws the same cycle, because the generator only depends on the seed and the migration */
+  std::vector<size_t> cycle(count);
+  std::iota(cycle.begin(), cycle.end(), 0);
+  Random random = Random::derive(m_seed, UINT64_MAX, migration);
+  for (size_t i = count - 1; i > 0; i --)
+  {
+    std::swap(cycle[i], cycle[random.bounded(i + 1)]);
+  }
+
+  size_t position = std::find(cycle.begin(), cycle.end(), island) - cycle.begin();
+  return cycle[(position + count - 1) % count];
+}
+
+/** Returns number of islands */
+size_t IslandModel::getIslandCount(void)
+{
+  return m_islands.size();
+}
+
+/** Returns board size */
+size_t IslandModel::getDimension(void)
+{
+  return m_dimension;
+}
+
+/** Returns seed of the run */
+uint64_t IslandModel::getSeed(void)
+{
+  return m_seed;
+}
+
+/** Returns the island */
+Genetic & IslandModel::getIsland(size_t island)
+{
+  return *m_islands[island];
+}
+
+/** Returns island whose generation with the index has the best fitness */
+size_t IslandModel::getBestIsland(size_t generation)
+{
+  size_t bestIsland = 0;
+  double bestFitness = DBL_MAX;
+  if (m_islands.size() == 1)
+    return bestIsland;
+
+  for (size_t i = 0; i < m_islands.size(); i ++)
+  {
+    if (generation >= m_islands[i] -> getGenerationsCount())
+      continue;
+
+    double fitness = m_islands[i] -> getNthSummary(generation).bestFitness;
+    if (fitness < bestFitness)
+    {
+      bestFitness = fitness;
+      bestIsland = i;
+    }
+  }
+
+  return bestIsland;
+}
+
+/** Returns number of generations of the solved island, of the island that is the furthest if there is no solution */
+size_t IslandModel::getGenerationsCount(void)
+{
+  // Islands that ran further before they saw the solution are not counted
+  const size_t solved = this -> getSolvedGenerations();
+  if (solved != SIZE_MAX)
+    return solved;
+
+  size_t count = 0;
+  for (auto & island: m_islands)
+  {
+    count = std::max(count, island -> getGenerationsCount());
+  }
+
+  return count;
+}
+
+/** Returns true if some island found a solution */
+bool IslandModel::isFinished(void)
+{
+  return m_solution.load(std::memory_order_acquire) != UINT64_MAX;
+}
+
+/** Returns index of the island that found the solution (getIslandCount() if there is none) */
+size_t IslandModel::getSolvedIsland(void)
+{
+  const uint64_t solution = m_solution.load(std::memory_order_acquire);
+  return solution == UINT64_MAX ? m_islands.size() : solution & (ISLAND_LIMIT - 1);
+}
+
+/** Returns number of fitness evaluations of all islands, only up to the generation of the solution if there is one */
+size_t IslandModel::getEvaluationsCount(void)
+{
+  const size_t solved = this -> getSolvedGenerations();
+  size_t count = 0;
+  for (auto & island: m_islands)
+  {
+    count += solved != SIZE_MAX ? island -> getEvaluationsCount(solved) : island -> getEvaluationsCount();
+  }
+
+  return count;
+}
+
+/** Returns counters of the fitness caches of all islands, only up to the generation of the solution if there is one */
+FitnessCacheStats IslandModel::getCacheStats(void)
+{
+  const size_t solved = this -> getSolvedGenerations();
+  FitnessCacheStats stats;
+  for (auto & island: m_islands)
+  {
+    stats += solved != SIZE_MAX ? island -> getCacheStats(solved) : island -> getCacheStats();
+  }
+
+  return stats;
+}
+
+/** Asks all islands to stop at their next generation boundary */
+void IslandModel::requestStop(void)
+{
+  for (auto & island: m_islands)
+  {
+    island -> requestStop();
+  }
+}
+
+/** Pauses all islands at their next generation boundary */
+void IslandModel::pause(void)
+{
+  for (auto & island: m_islands)
+  {
+    island -> pause();
+  }
+}
+
+/** Resumes all islands */
+void IslandModel::resume(void)
+{
+  for (auto & island: m_islands)
+  {
+    island -> resume();
+  }
+}
+
+/** Replaces the islands by new ones with the seed, so the model can run again */
+void IslandModel::restart(uint64_t seed)
+{
+  this -> createIslands(seed);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file islandModel.hpp
+ * @author Ondrej
+ * @brief Island model that runs several genetic algorithms in parallel and migrates individuals between them
+ *
+*/
+
+#pragma once
+
+#include "geneticAlgorithm.hpp"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <barrier>
+#include <mutex>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define ISLAND_COUNT 1 // One island is the classic single population genetic algorithm
+#define MIGRATION_INTERVAL 50 // Number of generations between migrations
+#define MIGRANT_COUNT 5 // Number of best individuals every island sends to the next one
+#define SOLVED_ISLAND_BITS 20 // Low bits of the packed solution that hold the island
+#define ISLAND_LIMIT (size_t(1) << SOLVED_ISLAND_BITS) // Maximal number of islands
+
+/** Decides which island receives the migrants of an island */
+enum class MigrationTopology
+{
+  Ring, // Island i sends to island i + 1
+  Random // Islands are shuffled into a random cycle for every migration
+};
+
+/** Runs islands (independent Genetic populations) each on its own thread, every MIGRATION_INTERVAL generations
+    the best individuals of every island replace the worst individuals of another island.
+    The island that finds a solution in the fewest generations finishes the whole run (islands that are behind
+    catch up to its generation first, so the same seed always gives the same winner) */
+class IslandModel
+{
+public:
+  IslandModel(size_t N, uint64_t seed = Random::randomSeed(), size_t islands = ISLAND_COUNT,
+              size_t migrationInterval = MIGRATION_INTERVAL, size_t migrants = MIGRANT_COUNT,
+              MigrationTopology topology = MigrationTopology::Ring, size_t threads = std::thread::hardware_concurrency(),
+              GeneticConfig config = GeneticConfig());
+
+  /** Creates model whose islands continue the run saved in the checkpoint, the threads do not change the result.
+      Throws std::runtime_error if the file is not a valid checkpoint of this build */
+  static std::unique_ptr<IslandModel> fromCheckpoint(const std::string & path,
+                                                     size_t threads = std::thread::hardware_concurrency());
+
+  /** Writes checkpoint of all islands into the writer every interval generations (nullptr stops it), has to be called
+      before the run and the writer has to outlive it. More islands are saved at the migrations, so the interval
+      has to be a multiple of the migration interval, throws std::invalid_argument otherwise */
+  void setCheckpoint(CheckpointWriter * writer, size_t interval = CHECKPOINT_INTERVAL);
+
+  /** Runs all islands and prints the result, returns true if some island found a solution */
+  bool run(void);
+
+  /** Runs all islands without printing, returns true if some island found a solution */
+  bool solve(void);
+
+  /** Returns number of islands */
+  size_t getIslandCount(void);
+
+  /** Returns board size */
+  size_t getDimension(void);
+
+  /** Returns seed of the run */
+  uint64_t getSeed(void);
+
+  /** Returns the island */
+  Genetic & getIsland(size_t island);
+
+  /** Returns island whose generation with the index has the best fitness */
+  size_t getBestIsland(size_t generation);
+
+  /** Returns number of generations of the solved island, of the island that is the furthest if there is no solution */
+  size_t getGenerationsCount(void);
+
+  /** Returns true if some island found a solution */
+  bool isFinished(void);
+
+  /** Returns index of the island that found the solution (getIslandCount() if there is none) */
+  size_t getSolvedIsland(void);
+
+  /** Returns number of fitness evaluations of all islands, only up to the generation of the solution if there is one */
+  size_t getEvaluationsCount(void);
+
+  /** Returns counters of the fitness caches of all islands, only up to the generation of the solution if there is one */
+  FitnessCacheStats getCacheStats(void);
+
+  /** Asks all islands to stop at their next generation boundary, can be called from any thread */
+  void requestStop(void);
+
+  /** Pauses all islands at their next generation boundary, paused islands sleep */
+  void pause(void);
+
+  /** Resumes all islands */
+  void resume(void);
+
+  /** Replaces the islands by new ones with the seed, so the model can run again. No island may be running,
+      the islands, their histories and references to their summaries are destroyed */
+  void restart(uint64_t seed);
+
+private:
+  /** Evolves one island and takes part in the migrations */
+  void runIsland(size_t island, std::barrier<> & barrier);
+
+  /** Returns island whose migrants the island receives in the migration */
+  size_t getSourceIsland(size_t island, size_t migration);
+
+  /** Creates the islands of the seed */
+  void createIslands(uint64_t seed);
+
+  /** Records the solution of the island unless another island solved the problem in fewer generations */
+  void claimSolution(size_t island, size_t generations);
+
+  /** Returns generations of the solution, SIZE_MAX if there is none */
+  size_t getSolvedGenerations(void);
+
+  /** Saves state of the island after the generation into its snapshot */
+  void snapshotIsland(size_t island, size_t generation);
+
+  /** Hands snapshots of all islands over to the checkpoint writer if all of them saved the generation */
+  void submitCheckpoint(size_t generation);
+
+  std::vector<std::unique_ptr<Genetic>> m_islands;
+  size_t m_dimension;
+  size_t m_islandCount;
+  size_t m_threads;
+  GeneticConfig m_config;
+  // Migrants sent by every island in the current migration
+  std::vector<std::vector<std::vector<size_t>>> m_mailboxes;
+  uint64_t m_seed;
+  size_t m_migrationInterval;
+  size_t m_migrants;
+  MigrationTopology m_topology;
+  // Generations of the solution in the high bits and the island in the low SOLVED_ISLAND_BITS (UINT64_MAX if there
+  // is no solution), one word, so the island and its generations are always read together and the smallest wins
+  std::atomic<uint64_t> m_solution;
+  // Not owned, null if the run is not checkpointed
+  CheckpointWriter * m_checkpoint = nullptr;
+  size_t m_checkpointInterval = CHECKPOINT_INTERVAL;
+  // State of every island at the last checkpoint and the generation it was saved after
+  std::vector<CheckpointBuffer> m_snapshots;
+  std::vector<size_t> m_snapshotGenerations;
+};
@@ -11,18 +11,47 @@
 /**
  * @brief Manages whole program
  * - Argument 1: Positive integer N that stands for chess board size (NxN)
+ * - Argument 2: Seed of the genetic algorithm (optional, random if not passed)
+ * - Argument 3: Number of islands (optional, one population by default)
+ * - Argument 4: Config file with the parameters of the genetic algorithm (optional, see GeneticConfig::load)
+ * - Or --replay FILE replays a run recorded by nqueens-solve --log FILE instead of computing one
 */
 int main (int argc, char ** argv)
 {
   // Default value if no arguments are passed
   size_t N = 8;
+  uint64_t seed = Random::randomSeed();
+  size_t islands = ISLAND_COUNT;
+  GeneticConfig config;
 
   // Incorrent number of arguments
-  if (argc > 2)
+  if (argc > 5)
     return EXIT_FAILURE;
 
+  /* Recorded run is replayed, it has its own board size */
+  if (argc >= 2 && std::string(argv[1]) == "--replay")
+  {
+    if (argc != 3)
+      return EXIT_FAILURE;
+
+    try
+    {
+      unsigned screenWidth = sf::VideoMode::getDesktopMode().width;
+      unsigned screenHeight = sf::VideoMode::getDesktopMode().height;
+      BoardVisualisation board(argv[2], screenWidth, screenHeight);
+      board.mainLoop();
+    }
+    catch (const std::runtime_error & error)
+    {
+      std::cerr << error.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
   // If one argument is passed
-  if (argc == 2)
+  if (argc >= 2)
   {
     std::istringstream parse(argv[1]);
     // If argument was not a number
@@ -30,10 +59,41 @@ int main (int argc, char ** argv)
       return EXIT_FAILURE;
   }
 
+  // If seed is passed
+  if (argc >= 3)
+  {
+    std::istringstream parse(argv[2]);
+    if (!(parse >> seed))
+      return EXIT_FAILURE;
+  }
+
+  // If number of islands is passed
+  if (argc >= 4)
+  {
+    std::istringstream parse(argv[3]);
+    if (!(parse >> islands) || islands == 0 || islands > ISLAND_LIMIT)
+      return EXIT_FAILURE;
+  }
+
+  // If config file is passed
+  if (argc == 5)
+  {
+    try
+    {
+      config.load(argv[4]);
+      config.validate();
+    }
+    catch (const std::invalid_argument & error)
+    {
+      std::cerr << error.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   /* Creates an instance of BoardVisualisation */
   unsigned screenWidth = sf::VideoMode::getDesktopMode().width;
   unsigned screenHeight = sf::VideoMode::getDesktopMode().height;
-  BoardVisualisation board(N, screenWidth, screenHeight);
+  BoardVisualisation board(N, screenWidth, screenHeight, seed, islands, config);
 
   /* Runs the main window loop*/
   board.mainLoop();
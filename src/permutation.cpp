@@ -0,0 +1,126 @@
+/**
+ * @file permutation.cpp
+ * @author Ondrej
+ * @brief Variation operators of the permutation encoding (every column is used by exactly one queen)
+ *
+*/
+
+#include "permutation.hpp"
+
+#include <numeric>
+#include <utility>
+
+namespace
+{
+  /** PMX child of one direction, child starts as a copy of other and the segment genes are swapped into place */
+  void pmxChild(const std::vector<size_t> & segmentParent, const std::vector<size_t> & other, size_t begin, size_t end,
+                std::vector<size_t> & child)
+  {
+    // Positions of the genes in the child, so the gene to swap is found in O(1)
+    static thread_local std::vector<size_t> position;
+
+    child = other;
+    position.resize(child.size());
+    for (size_t i = 0; i < child.size(); i ++)
+      position[child[i]] = i;
+
+    /* Swapping keeps the child a permutation and gives the same child as following the PMX mapping chains */
+    for (size_t i = begin; i < end; i ++)
+    {
+      size_t from = position[segmentParent[i]];
+      std::swap(child[i], child[from]);
+      position[child[from]] = from;
+      position[child[i]] = i;
+    }
+  }
+
+  /** OX child of one direction */
+  void oxChild(const std::vector<size_t> & segmentParent, const std::vector<size_t> & other, size_t begin, size_t end,
+               std::vector<size_t> & child)
+  {
+    static thread_local std::vector<char> used;
+
+    size_t N = segmentParent.size();
+    child.resize(N);
+    used.assign(N, false);
+    for (size_t i = begin; i < end; i ++)
+    {
+      child[i] = segmentParent[i];
+      used[child[i]] = true;
+    }
+
+    /* Remaining positions are filled from end (wrapping), genes are read from the other parent starting at end */
+    size_t target = end % N;
+    for (size_t k = 0; k < N; k ++)
+    {
+      size_t gene = other[(end + k) % N];
+      if (used[gene])
+        continue;
+
+      child[target] = gene;
+      target = (target + 1) % N;
+    }
+  }
+}
+
+/** Fills the individual with a uniformly random permutation of [0, N - 1] */
+void randomPermutation(std::vector<size_t> & individual, size_t N, Random & random)
+{
+  individual.resize(N);
+  std::iota(individual.begin(), individual.end(), 0);
+
+  // Fisher-Yates shuffle
+  for (size_t i = N; i > 1; i --)
+  {
+    std::swap(individual[i - 1], individual[random.bounded(i)]);
+  }
+}
+
+/** Partially mapped crossover (PMX) */
+void pmxCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2, size_t begin, size_t end,
+                  std::vector<size_t> & child1, std::vector<size_t> & child2)
+{
+  pmxChild(parent1, parent2, begin, end, child1);
+  pmxChild(parent2, parent1, begin, end, child2);
+}
+
+/** Order crossover (OX) */
+void oxCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2, size_t begin, size_t end,
+                 std::vector<size_t> & child1, std::vector<size_t> & child2)
+{
+  oxChild(parent1, parent2, begin, end, child1);
+  oxChild(parent2, parent1, begin, end, child2);
+}
+
+/** Cycle crossover (CX) */
+void cycleCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2,
+                    std::vector<size_t> & child1, std::vector<size_t> & child2)
+{
+  static thread_local std::vector<size_t> position;
+  static thread_local std::vector<char> visited;
+
+  size_t N = parent1.size();
+  child1.resize(N);
+  child2.resize(N);
+  position.resize(N);
+  visited.assign(N, false);
+  for (size_t i = 0; i < N; i ++)
+    position[parent1[i]] = i;
+
+  bool swapped = false;
+  for (size_t start = 0; start < N; start ++)
+  {
+    if (visited[start])
+      continue;
+
+    /* Follows the cycle parent1[i] -> parent2[i] -> position of that gene in parent1 back to the start */
+    for (size_t i = start; !visited[i]; i = position[parent2[i]])
+    {
+      visited[i] = true;
+      child1[i] = swapped ? parent2[i] : parent1[i];
+      child2[i] = swapped ? parent1[i] : parent2[i];
+    }
+
+    swapped = !swapped;
+  }
+}
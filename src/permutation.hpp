@@ -0,0 +1,31 @@
+/**
+ * @file permutation.hpp
+ * @author Ondrej
+ * @brief Variation operators of the permutation encoding (every column is used by exactly one queen)
+ *
+*/
+
+#pragma once
+
+#include "random.hpp"
+
+#include <vector>
+#include <cstddef>
+
+/** Fills the individual with a uniformly random permutation of [0, N - 1] */
+void randomPermutation(std::vector<size_t> & individual, size_t N, Random & random);
+
+/** Partially mapped crossover (PMX), children take genes [begin, end) from one parent, other genes come from the
+    other parent and genes that would repeat are mapped through the segment */
+void pmxCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2, size_t begin, size_t end,
+                  std::vector<size_t> & child1, std::vector<size_t> & child2);
+
+/** Order crossover (OX), children take genes [begin, end) from one parent, other genes are filled from end (wrapping)
+    in the order in which they follow in the other parent */
+void oxCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2, size_t begin, size_t end,
+                 std::vector<size_t> & child1, std::vector<size_t> & child2);
+
+/** Cycle crossover (CX), positions are split into the cycles of the two parents, children take the cycles
+    alternately from the first and from the second parent, so every gene keeps the position from one of the parents */
+void cycleCrossover(const std::vector<size_t> & parent1, const std::vector<size_t> & parent2,
+                    std::vector<size_t> & child1, std::vector<size_t> & child2);
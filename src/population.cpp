@@ -0,0 +1,136 @@
+/**
+ * @file population.cpp
+ * @author Ondrej
+ * @brief Structure of arrays storage of the individuals of one generation
+ *
+*/
+
+#include "population.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+  /** Converts genome between the stored and the public representation */
+  template <typename From, typename To>
+  void copyGenes(const From * from, To * to, size_t count)
+  {
+    for (size_t i = 0; i < count; i ++)
+      to[i] = static_cast<To>(from[i]);
+  }
+}
+
+/** Sets board size and picks the gene width, population has to be empty */
+void Population::setDimension(size_t dimension)
+{
+  if (m_size != 0)
+    throw std::logic_error("Population dimension can not change");
+
+  m_dimension = dimension;
+  // Genes are in range [0, N - 1]
+  if (dimension <= UINT8_MAX + 1)
+    m_geneWidth = 1;
+  else if (dimension <= UINT16_MAX + 1)
+    m_geneWidth = 2;
+  else
+    m_geneWidth = 4;
+}
+
+/** Returns board size (number of genes of every individual) */
+size_t Population::dimension(void) const
+{
+  return m_dimension;
+}
+
+/** Returns number of bytes of one gene (1, 2 or 4) */
+size_t Population::geneWidth(void) const
+{
+  return m_geneWidth;
+}
+
+/** Returns number of individuals */
+size_t Population::size(void) const
+{
+  return m_size;
+}
+
+/** Reserves space for the individuals */
+void Population::reserve(size_t count)
+{
+  m_genes.reserve(count * m_dimension * m_geneWidth);
+  m_fitness.reserve(count);
+}
+
+/** Removes all individuals (keeps the memory) */
+void Population::clear(void)
+{
+  m_size = 0;
+  m_genes.clear();
+  m_fitness.clear();
+}
+
+/** Changes number of individuals, new slots are filled by setGenome */
+void Population::resize(size_t count)
+{
+  m_genes.resize(count * m_dimension * m_geneWidth);
+  m_fitness.resize(count);
+  m_size = count;
+}
+
+/** Appends individual with its fitness */
+void Population::push(const std::vector<size_t> & genome, double fitness)
+{
+  /* Dimension of an empty population is taken from the first individual */
+  if (m_size == 0 && genome.size() != m_dimension)
+    this -> setDimension(genome.size());
+
+  this -> resize(m_size + 1);
+  this -> setGenome(m_size - 1, genome, fitness);
+}
+
+/** Overwrites individual in the slot, different slots can be written from different threads */
+void Population::setGenome(size_t index, const std::vector<size_t> & genome, double fitness)
+{
+  if (genome.size() != m_dimension)
+    throw std::invalid_argument("Individual does not match the board size");
+
+  unsigned char * target = m_genes.data() + index * m_dimension * m_geneWidth;
+
+  switch (m_geneWidth)
+  {
+    case 1:
+      copyGenes(genome.data(), reinterpret_cast<uint8_t *>(target), m_dimension);
+      break;
+    case 2:
+      copyGenes(genome.data(), reinterpret_cast<uint16_t *>(target), m_dimension);
+      break;
+    default:
+      copyGenes(genome.data(), reinterpret_cast<uint32_t *>(target), m_dimension);
+  }
+
+  m_fitness[index] = fitness;
+}
+
+/** Copies genome of the individual into the vector */
+void Population::getGenome(size_t index, std::vector<size_t> & genome) const
+{
+  genome.resize(m_dimension);
+  this -> visitGenes(index, [&] (const auto * genes)
+  {
+    copyGenes(genes, genome.data(), m_dimension);
+  });
+}
+
+/** Returns genome of the individual */
+std::vector<size_t> Population::getGenome(size_t index) const
+{
+  std::vector<size_t> genome;
+  this -> getGenome(index, genome);
+  return genome;
+}
+
+/** Returns fitness of all individuals */
+const std::vector<double> & Population::fitness(void) const
+{
+  return m_fitness;
+}
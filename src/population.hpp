@@ -0,0 +1,131 @@
+/**
+ * @file population.hpp
+ * @author Ondrej
+ * @brief Structure of arrays storage of the individuals of one generation
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#define POPULATION_ALIGNMENT 64 // Genome buffer is aligned to the cache line
+
+/** Allocator that aligns the buffer to POPULATION_ALIGNMENT bytes */
+template <typename T>
+struct AlignedAllocator
+{
+  using value_type = T;
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U> &) {}
+
+  T * allocate(size_t n)
+  {
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(POPULATION_ALIGNMENT)));
+  }
+
+  void deallocate(T * pointer, size_t)
+  {
+    ::operator delete(pointer, std::align_val_t(POPULATION_ALIGNMENT));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U> &) const
+  {
+    return true;
+  }
+};
+
+/** Stores genomes of all individuals in one flat buffer (individual i starts at i * N) and fitness in a separate array.
+    Genes never exceed N, so they are stored in the narrowest unsigned type that can hold the board size */
+class Population
+{
+public:
+  explicit Population(size_t dimension = 0)
+  {
+    this -> setDimension(dimension);
+  };
+
+  /** Sets board size and picks the gene width, population has to be empty */
+  void setDimension(size_t dimension);
+
+  /** Returns board size (number of genes of every individual) */
+  size_t dimension(void) const;
+
+  /** Returns number of bytes of one gene (1, 2 or 4) */
+  size_t geneWidth(void) const;
+
+  /** Returns number of individuals */
+  size_t size(void) const;
+
+  /** Reserves space for the individuals */
+  void reserve(size_t count);
+
+  /** Removes all individuals (keeps the memory) */
+  void clear(void);
+
+  /** Changes number of individuals, new slots are filled by setGenome */
+  void resize(size_t count);
+
+  /** Appends individual with its fitness */
+  void push(const std::vector<size_t> & genome, double fitness);
+
+  /** Overwrites individual in the slot, different slots can be written from different threads */
+  void setGenome(size_t index, const std::vector<size_t> & genome, double fitness);
+
+  /** Copies genome of the individual into the vector */
+  void getGenome(size_t index, std::vector<size_t> & genome) const;
+
+  /** Returns genome of the individual */
+  std::vector<size_t> getGenome(size_t index) const;
+
+  /** Returns fitness of the individual */
+  double getFitness(size_t index) const
+  {
+    return m_fitness[index];
+  };
+
+  /** Overwrites fitness of the individual, different slots can be written from different threads */
+  void setFitness(size_t index, double fitness)
+  {
+    m_fitness[index] = fitness;
+  };
+
+  /** Returns fitness of all individuals */
+  const std::vector<double> & fitness(void) const;
+
+  /** Returns typed pointer to the genes of the individual, Gene has to match geneWidth() */
+  template <typename Gene>
+  const Gene * genes(size_t index) const
+  {
+    return reinterpret_cast<const Gene *>(m_genes.data()) + index * m_dimension;
+  }
+
+  /** Calls visitor with a pointer of the stored gene type (uint8_t, uint16_t or uint32_t) to the genes of the individual */
+  template <typename Visitor>
+  decltype(auto) visitGenes(size_t index, Visitor && visitor) const
+  {
+    switch (m_geneWidth)
+    {
+      case 1:
+        return visitor(this -> genes<uint8_t>(index));
+      case 2:
+        return visitor(this -> genes<uint16_t>(index));
+      default:
+        return visitor(this -> genes<uint32_t>(index));
+    }
+  }
+
+private:
+  size_t m_dimension = 0;
+  size_t m_geneWidth = 1;
+  size_t m_size = 0;
+  std::vector<unsigned char, AlignedAllocator<unsigned char>> m_genes;
+  std::vector<double> m_fitness;
+};
@@ -0,0 +1,65 @@
+/**
+ * @file profiler.cpp
+ * @author Ondrej
+ * @brief Per-phase timers and counters of the generation step, compiled out if NQUEENS_PROFILE is 0
+ *
+*/
+
+#include "profiler.hpp"
+
+#include <sstream>
+
+/** Returns name of the phase (as used in the JSON lines) */
+const char * phaseName(Phase phase)
+{
+  switch (phase)
+  {
+    case Phase::Random: return "random";
+    case Phase::Selection: return "selection";
+    case Phase::Crossover: return "crossover";
+    case Phase::Mutation: return "mutation";
+    case Phase::Evaluation: return "evaluation";
+    case Phase::Sorting: return "sorting";
+    case Phase::LocalSearch: return "local_search";
+    case Phase::Duplicates: return "duplicates";
+    case Phase::LockWait: return "lock_wait";
+    case Phase::HistoryPush: return "history_push";
+    case Phase::Total: return "total";
+    case Phase::Count: break;
+  }
+
+  return "unknown";
+}
+
+/** Adds time and calls of all phases of another profile (generation is kept) */
+PhaseProfile & PhaseProfile::operator+=(const PhaseProfile & other)
+{
+  for (size_t i = 0; i < PHASE_COUNT; i ++)
+  {
+    nanoseconds[i] += other.nanoseconds[i];
+    counts[i] += other.counts[i];
+  }
+
+  return *this;
+}
+
+/** Clears time and calls of all phases */
+void PhaseProfile::clear(void)
+{
+  nanoseconds.fill(0);
+  counts.fill(0);
+}
+
+/** Returns the profile as one JSON object, e.g. {"island":0,"generation":5,"crossover":{"ns":1200,"count":236},...} */
+std::string PhaseProfile::toJson(size_t island) const
+{
+  std::ostringstream json;
+  json << "{\"island\":" << island << ",\"generation\":" << generation;
+  for (size_t i = 0; i < PHASE_COUNT; i ++)
+  {
+    json << ",\"" << phaseName(static_cast<Phase>(i)) << "\":{\"ns\":" << nanoseconds[i] << ",\"count\":" << counts[i] << "}";
+  }
+  json << "}";
+
+  return json.str();
+}
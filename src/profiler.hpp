@@ -0,0 +1,117 @@
+/**
+ * @file profiler.hpp
+ * @author Ondrej
+ * @brief Per-phase timers and counters of the generation step, compiled out if NQUEENS_PROFILE is 0
+ *
+*/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef NQUEENS_PROFILE
+#define NQUEENS_PROFILE 1 // 0 removes the timers and counters from the solver (make PROFILE=0)
+#endif
+
+#define PROFILE_SAMPLE_INTERVAL 8 // Every Nth breeding task is timed, reading the clock for every child would cost more than the child
+
+/** Phases of the generation step */
+enum class Phase
+{
+  Random, // Random draws of the breeding and the local search (counted, not timed)
+  Selection, // Choosing the parents (tournaments, elites) and copying them out of the generation
+  Crossover,
+  Mutation,
+  Evaluation, // Storing the children with their fitness (updated from the parents' counters) and rescoring from scratch
+  Sorting, // Partial sort of the elites (getNBestIndices)
+  LocalSearch,
+  Duplicates, // Fitness cache lookups and rejected duplicates
+  LockWait, // Waiting for the history lock
+  HistoryPush, // Publishing the generation while the lock is held
+  Total, // Wall time of the whole step
+  Count
+};
+
+#define PHASE_COUNT static_cast<size_t>(Phase::Count)
+
+/** Returns name of the phase (as used in the JSON lines) */
+const char * phaseName(Phase phase);
+
+/** Time and number of calls of every phase of one generation. Time of the phases that run on the workers is summed
+    over the workers (so it can exceed the wall time) and the breeding phases are estimated from the sampled tasks */
+struct PhaseProfile
+{
+  size_t generation = 0;
+  std::array<uint64_t, PHASE_COUNT> nanoseconds {};
+  std::array<uint64_t, PHASE_COUNT> counts {};
+
+  /** Adds time and calls to the phase */
+  void add(Phase phase, uint64_t time, uint64_t calls = 1)
+  {
+    nanoseconds[static_cast<size_t>(phase)] += time;
+    counts[static_cast<size_t>(phase)] += calls;
+  };
+
+  /** Returns time of the phase in nanoseconds */
+  uint64_t time(Phase phase) const
+  {
+    return nanoseconds[static_cast<size_t>(phase)];
+  };
+
+  /** Returns number of calls of the phase */
+  uint64_t count(Phase phase) const
+  {
+    return counts[static_cast<size_t>(phase)];
+  };
+
+  /** Adds time and calls of all phases of another profile (generation is kept) */
+  PhaseProfile & operator+=(const PhaseProfile & other);
+
+  /** Clears time and calls of all phases */
+  void clear(void);
+
+  /** Returns the profile as one JSON object without a line break */
+  std::string toJson(size_t island) const;
+};
+
+/** Returns monotonic time in nanoseconds, 0 if profiling is compiled out */
+inline uint64_t profileNow(void)
+{
+  if constexpr (NQUEENS_PROFILE)
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  else
+    return 0;
+}
+
+/** Adds calls and, if timed is true, time of its scope to the phase, does nothing if profiling is compiled out */
+class PhaseTimer
+{
+public:
+  PhaseTimer(PhaseProfile & profile, Phase phase, bool timed = true, uint64_t calls = 1)
+    : m_profile(profile),
+      m_phase(phase),
+      m_calls(calls),
+      m_start(timed ? profileNow() : 0),
+      m_timed(timed)
+  {};
+
+  ~PhaseTimer()
+  {
+    if constexpr (NQUEENS_PROFILE)
+      m_profile.add(m_phase, m_timed ? profileNow() - m_start : 0, m_calls);
+  };
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer & operator=(const PhaseTimer &) = delete;
+
+private:
+  PhaseProfile & m_profile;
+  Phase m_phase;
+  uint64_t m_calls;
+  uint64_t m_start;
+  bool m_timed;
+};
@@ -0,0 +1,34 @@
+/**
+ * @file random.cpp
+ * @author Ondrej
+ * @brief Fast seeded pseudo random generator (xoshiro256**) used by the genetic algorithm
+ *
+*/
+
+#include "random.hpp"
+
+#include <random>
+
+/** Expands the seed into the generator state using splitmix64 (state can never be all zeros) */
+void Random::seed(uint64_t seed)
+{
+  for (uint64_t & word: m_state)
+  {
+    seed += 0x9e3779b97f4a7c15ULL;
+    word = Random::mix(seed);
+  }
+}
+
+/** Returns a non-deterministic seed (the only place that uses std::random_device) */
+uint64_t Random::randomSeed(void)
+{
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+}
+
+/** Returns independent generator for the (stream, task) pair of the seed, so a task draws the same numbers
+    no matter which thread runs it */
+Random Random::derive(uint64_t seed, uint64_t stream, uint64_t task)
+{
+  return Random(Random::mix(Random::mix(seed ^ Random::mix(stream)) + task));
+}
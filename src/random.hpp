@@ -0,0 +1,137 @@
+/**
+ * @file random.hpp
+ * @author Ondrej
+ * @brief Fast seeded pseudo random generator (xoshiro256**) used by the genetic algorithm
+ *
+*/
+
+#pragma once
+
+#include "profiler.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+/** xoshiro256** generator with bounded integer, Bernoulli and geometric draws.
+    Constructing it is cheap and does not touch std::random_device, so it can be kept per thread */
+class Random
+{
+public:
+  explicit Random(uint64_t seed = 0)
+  {
+    this -> seed(seed);
+  };
+
+  /** Expands the seed into the generator state */
+  void seed(uint64_t seed);
+
+  /** Returns next 64 random bits */
+  uint64_t next(void)
+  {
+    const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+    const uint64_t t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    if constexpr (NQUEENS_PROFILE)
+      m_draws ++;
+
+    return result;
+  };
+
+  /** Returns number of 64 bit draws since the generator was created (0 if profiling is compiled out) */
+  uint64_t draws(void) const
+  {
+    return m_draws;
+  };
+
+  /** Copies the generator state into state, so the stream can be continued by setState (e.g. after a restart) */
+  void getState(uint64_t state[4]) const
+  {
+    for (size_t i = 0; i < 4; i ++)
+      state[i] = m_state[i];
+  };
+
+  /** Continues the stream from the state returned by getState */
+  void setState(const uint64_t state[4])
+  {
+    for (size_t i = 0; i < 4; i ++)
+      m_state[i] = state[i];
+  };
+
+  /** Returns random integer in range [0, n - 1] without modulo bias (Lemire's method) */
+  size_t bounded(size_t n)
+  {
+    __extension__ using Wide = unsigned __int128;
+
+    Wide product = static_cast<Wide>(this -> next()) * n;
+    uint64_t low = static_cast<uint64_t>(product);
+    if (low < n)
+    {
+      const uint64_t threshold = -static_cast<uint64_t>(n) % n;
+      while (low < threshold)
+      {
+        product = static_cast<Wide>(this -> next()) * n;
+        low = static_cast<uint64_t>(product);
+      }
+    }
+
+    return static_cast<size_t>(product >> 64);
+  };
+
+  /** Returns random number in range [0, 1) */
+  double uniform(void)
+  {
+    return (this -> next() >> 11) * 0x1.0p-53;
+  };
+
+  /** Returns true with probability p */
+  bool bernoulli(double p)
+  {
+    return this -> uniform() < p;
+  };
+
+  /** Returns number of failed Bernoulli(p) trials before the first success, so per-gene decisions
+      can be replaced by jumping straight to the next gene that changes.
+      Result is capped at SIZE_MAX / 2, so it can be safely added to an index */
+  size_t geometric(double p)
+  {
+    if (p >= 1.0)
+      return 0;
+    if (p <= 0.0)
+      return SIZE_MAX / 2;
+
+    double skip = std::floor(std::log1p(-this -> uniform()) / std::log1p(-p));
+    return skip >= static_cast<double>(SIZE_MAX / 2) ? SIZE_MAX / 2 : static_cast<size_t>(skip);
+  };
+
+  /** Returns a non-deterministic seed (the only place that uses std::random_device) */
+  static uint64_t randomSeed(void);
+
+  /** Mixes the value into a well distributed 64 bit number (splitmix64 finalizer) */
+  static uint64_t mix(uint64_t value)
+  {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+  };
+
+  /** Returns independent generator for the (stream, task) pair of the seed, so a task draws the same numbers
+      no matter which thread runs it */
+  static Random derive(uint64_t seed, uint64_t stream, uint64_t task);
+
+private:
+  static uint64_t rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  };
+
+  uint64_t m_state[4];
+  uint64_t m_draws = 0;
+};
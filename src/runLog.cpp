@@ -0,0 +1,416 @@
+/**
+ * @file runLog.cpp
+ * @author Ondrej
+ * @brief Append-only binary log of a run, written in the background and read back through mmap
+ *
+*/
+
+#include "runLog.hpp"
+#include "geneticAlgorithm.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  const char HEADER_MAGIC[8] = {'N', 'Q', 'R', 'U', 'N', 'L', 'O', 'G'};
+  const char FOOTER_MAGIC[8] = {'N', 'Q', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+  /** Rounds the size up to the 8 byte alignment of the parts of the file */
+  size_t align8(size_t size)
+  {
+    return (size + 7) & ~static_cast<size_t>(7);
+  }
+}
+
+RunLogWriter::RunLogWriter(const std::string & path, bool populations)
+  : m_path(path),
+    m_file(path, std::ios::binary | std::ios::trunc),
+    m_populations(populations)
+{
+  if (!m_file)
+    throw std::runtime_error("Can not create run log " + path);
+
+  m_writer = std::thread(&RunLogWriter::writerLoop, this);
+}
+
+/** Closes the log (errors are ignored, call close to see them) */
+RunLogWriter::~RunLogWriter()
+{
+  this -> finish();
+}
+
+/** Writes the header, has to be called once before the first append */
+void RunLogWriter::begin(size_t dimension, size_t populationCapacity, uint64_t seed)
+{
+  if (m_started)
+    throw std::logic_error("Run log " + m_path + " is already started");
+
+  m_started = true;
+  m_dimension = dimension;
+  m_geneWidth = Population(dimension).geneWidth();
+  m_populationCapacity = m_populations ? populationCapacity : 0;
+
+  /* Record: fixed part, best genome, fitness and genomes of the population */
+  m_recordSize = sizeof(RunLogRecord) + align8(m_dimension * m_geneWidth);
+  m_recordSize += m_populationCapacity * sizeof(double) + align8(m_populationCapacity * m_dimension * m_geneWidth);
+
+  RunLogHeader header = {};
+  std::memcpy(header.magic, HEADER_MAGIC, sizeof(header.magic));
+  header.version = RUN_LOG_VERSION;
+  header.geneWidth = m_geneWidth;
+  header.dimension = m_dimension;
+  header.populationCapacity = m_populationCapacity;
+  header.seed = seed;
+  header.recordSize = m_recordSize;
+
+  std::unique_lock<std::mutex> lock (m_mtx);
+  const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&header);
+  m_pending.insert(m_pending.end(), bytes, bytes + sizeof(header));
+}
+
+/** Appends record of the generation */
+void RunLogWriter::append(Generation & generation)
+{
+  if (!m_started || m_closed)
+    throw std::logic_error("Run log " + m_path + " is not open");
+
+  const Population & population = generation.getPopulation();
+  size_t count = m_populations ? std::min(population.size(), m_populationCapacity) : 0;
+
+  RunLogRecord record = {};
+  record.index = generation.getIndex();
+  record.bestFitness = generation.fitnessBest();
+  record.averageFitness = generation.fitnessAverage();
+  record.mutationRate = generation.getMutationRate();
+  record.crossoverRate = generation.getCrossoverRate();
+  record.populationSize = count;
+  size_t best = generation.bestIndex();
+
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_offsets.push_back(sizeof(RunLogHeader) + m_offsets.size() * m_recordSize);
+
+  /* Record is serialised straight into the pending buffer, unused space is zeroed */
+  size_t start = m_pending.size();
+  m_pending.resize(start + m_recordSize, 0);
+  unsigned char * out = m_pending.data() + start;
+  std::memcpy(out, &record, sizeof(record));
+  out += sizeof(record);
+
+  const size_t genomeBytes = m_dimension * m_geneWidth;
+  if (population.size() != 0)
+  {
+    population.visitGenes(best, [&] (const auto * genes)
+    {
+      std::memcpy(out, genes, genomeBytes);
+    });
+  }
+  out += align8(genomeBytes);
+
+  if (m_populationCapacity != 0)
+  {
+    std::memcpy(out, population.fitness().data(), count * sizeof(double));
+    out += m_populationCapacity * sizeof(double);
+    if (count != 0)
+    {
+      population.visitGenes(0, [&] (const auto * genes)
+      {
+        std::memcpy(out, genes, count * genomeBytes);
+      });
+    }
+  }
+
+  if (m_pending.size() >= RUN_LOG_FLUSH_SIZE)
+    m_wake.notify_one();
+}
+
+/** Writes the remaining records and the footer, throws std::runtime_error if writing failed */
+void RunLogWriter::close(void)
+{
+  if (!this -> finish())
+    throw std::runtime_error("Can not write run log " + m_path);
+}
+
+/** Returns number of appended records */
+size_t RunLogWriter::size(void) const
+{
+  return m_offsets.size();
+}
+
+/** Writes the buffers handed over by append until the log is closed */
+void RunLogWriter::writerLoop(void)
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  while (true)
+  {
+    m_wake.wait(lock, [this] ()
+    {
+      return m_stopping || m_pending.size() >= RUN_LOG_FLUSH_SIZE;
+    });
+
+    /* Take the pending records and write them while append fills the other buffer */
+    std::swap(m_pending, m_writing);
+    bool stopping = m_stopping;
+    lock.unlock();
+
+    if (!m_writing.empty() && !m_file.write(reinterpret_cast<const char *>(m_writing.data()), m_writing.size()))
+      m_failed = true;
+    m_writing.clear();
+
+    lock.lock();
+    if (stopping && m_pending.empty())
+      return;
+  }
+}
+
+/** Stops the writer thread and writes the footer, returns false if some write failed */
+bool RunLogWriter::finish(void)
+{
+  if (m_closed)
+    return !m_failed;
+  m_closed = true;
+
+  {
+    std::unique_lock<std::mutex> lock (m_mtx);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_writer.join();
+
+  /* Footer is written only after all records, so a log with the footer is complete */
+  if (m_started)
+  {
+    RunLogFooter footer = {};
+    footer.recordCount = m_offsets.size();
+    footer.indexOffset = sizeof(RunLogHeader) + m_offsets.size() * m_recordSize;
+    std::memcpy(footer.magic, FOOTER_MAGIC, sizeof(footer.magic));
+
+    m_file.write(reinterpret_cast<const char *>(m_offsets.data()), m_offsets.size() * sizeof(uint64_t));
+    m_file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+  }
+
+  m_file.close();
+  if (!m_file)
+    m_failed = true;
+
+  return !m_failed;
+}
+
+
+/** Maps the file, throws std::runtime_error if it is not a valid log */
+RunLogReader::RunLogReader(const std::string & path)
+{
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0)
+    throw std::runtime_error("Can not open run log " + path);
+
+  struct stat info;
+  if (::fstat(descriptor, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RunLogHeader))
+  {
+    ::close(descriptor);
+    throw std::runtime_error("Run log " + path + " is too short");
+  }
+
+  m_length = info.st_size;
+  void * data = ::mmap(nullptr, m_length, PROT_READ, MAP_SHARED, descriptor, 0);
+  // Mapping stays valid after the descriptor is closed
+  ::close(descriptor);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Can not map run log " + path);
+
+  m_data = static_cast<const unsigned char *>(data);
+  m_header = reinterpret_cast<const RunLogHeader *>(m_data);
+
+  try
+  {
+    this -> validate(path);
+  }
+  catch (...)
+  {
+    ::munmap(const_cast<unsigned char *>(m_data), m_length);
+    throw;
+  }
+}
+
+/** Checks the header and the index against the length of the file, so no record read can leave the mapping.
+    Sizes are bounded before they are multiplied, a corrupt header can not overflow them */
+void RunLogReader::validate(const std::string & path)
+{
+  const RunLogHeader & header = *m_header;
+  if (std::memcmp(header.magic, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0 || header.version != RUN_LOG_VERSION)
+    throw std::runtime_error(path + " is not a run log");
+
+  // Genes are in range [0, N - 1] and their width is picked from N, like in the population the writer logged
+  if (header.dimension == 0 || header.dimension > UINT32_MAX + 1ull || header.geneWidth != Population(header.dimension).geneWidth())
+    throw std::runtime_error("Run log " + path + " has an invalid board size");
+
+  // Population part of the record has to fit into half of the address space, so the record size does not overflow
+  const size_t genomeBytes = header.dimension * header.geneWidth;
+  if (header.populationCapacity > SIZE_MAX / 2 / (sizeof(double) + genomeBytes))
+    throw std::runtime_error("Run log " + path + " has an invalid population capacity");
+
+  /* Record size is fixed by the other fields, the same way as the writer computes it */
+  size_t recordSize = sizeof(RunLogRecord) + align8(genomeBytes);
+  recordSize += header.populationCapacity * sizeof(double) + align8(header.populationCapacity * genomeBytes);
+  if (header.recordSize != recordSize)
+    throw std::runtime_error("Run log " + path + " has an invalid record size");
+
+  /* Closed log has the index in its footer, otherwise every whole record is readable */
+  m_size = (m_length - sizeof(RunLogHeader)) / recordSize;
+  if (m_length < sizeof(RunLogHeader) + sizeof(RunLogFooter))
+    return;
+
+  const RunLogFooter * footer = reinterpret_cast<const RunLogFooter *>(m_data + m_length - sizeof(RunLogFooter));
+  if (std::memcmp(footer -> magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0)
+    return;
+
+  // Index lies between the records and the footer and fills the space exactly
+  const size_t indexSpace = m_length - sizeof(RunLogHeader) - sizeof(RunLogFooter);
+  if (footer -> recordCount > indexSpace / sizeof(uint64_t)
+      || footer -> indexOffset != m_length - sizeof(RunLogFooter) - footer -> recordCount * sizeof(uint64_t)
+      || footer -> indexOffset % alignof(uint64_t) != 0)
+    throw std::runtime_error("Run log " + path + " has an invalid index");
+
+  const uint64_t * offsets = reinterpret_cast<const uint64_t *>(m_data + footer -> indexOffset);
+  for (size_t i = 0; i < footer -> recordCount; i ++)
+  {
+    // Every record has to end before the index
+    if (offsets[i] < sizeof(RunLogHeader) || offsets[i] % alignof(RunLogRecord) != 0
+        || offsets[i] > footer -> indexOffset - std::min<uint64_t>(recordSize, footer -> indexOffset))
+      throw std::runtime_error("Run log " + path + " has an invalid index");
+  }
+
+  m_size = footer -> recordCount;
+  m_offsets = offsets;
+}
+
+RunLogReader::~RunLogReader()
+{
+  ::munmap(const_cast<unsigned char *>(m_data), m_length);
+}
+
+/** Returns number of records */
+size_t RunLogReader::size(void) const
+{
+  return m_size;
+}
+
+/** Returns board size */
+size_t RunLogReader::dimension(void) const
+{
+  return m_header -> dimension;
+}
+
+/** Returns seed of the logged run */
+uint64_t RunLogReader::seed(void) const
+{
+  return m_header -> seed;
+}
+
+/** Returns true if the records keep whole populations */
+bool RunLogReader::hasPopulations(void) const
+{
+  return m_header -> populationCapacity != 0;
+}
+
+/** Returns true if the log was closed (false if the run was interrupted) */
+bool RunLogReader::isComplete(void) const
+{
+  return m_offsets != nullptr;
+}
+
+/** Returns fixed part of the Nth record */
+const RunLogRecord & RunLogReader::getRecord(size_t N) const
+{
+  return *reinterpret_cast<const RunLogRecord *>(this -> record(N));
+}
+
+/** Returns stats and the best individual of the Nth generation */
+GenerationSummary RunLogReader::getSummary(size_t N) const
+{
+  const RunLogRecord & record = this -> getRecord(N);
+
+  GenerationSummary summary;
+  summary.index = record.index;
+  summary.bestFitness = record.bestFitness;
+  summary.averageFitness = record.averageFitness;
+  summary.mutationRate = record.mutationRate;
+  summary.crossoverRate = record.crossoverRate;
+  this -> readGenes(this -> record(N) + sizeof(RunLogRecord), summary.bestIndividual);
+  return summary;
+}
+
+/** Returns the Nth generation, whole if the log keeps populations, otherwise only its best individual */
+Generation RunLogReader::getGeneration(size_t N) const
+{
+  const RunLogRecord & record = this -> getRecord(N);
+  if (record.populationSize == 0)
+    return Generation(this -> getSummary(N));
+  if (record.populationSize > m_header -> populationCapacity)
+    throw std::runtime_error("Run log record " + std::to_string(N) + " has more individuals than fit into it");
+
+  const size_t genomeBytes = m_header -> dimension * m_header -> geneWidth;
+  const unsigned char * fitness = this -> record(N) + sizeof(RunLogRecord) + align8(genomeBytes);
+  const unsigned char * genes = fitness + m_header -> populationCapacity * sizeof(double);
+
+  Generation generation(record.index, record.mutationRate, record.crossoverRate);
+  generation.reserve(record.populationSize, m_header -> dimension);
+  std::vector<size_t> individual;
+  for (size_t i = 0; i < record.populationSize; i ++)
+  {
+    double value;
+    std::memcpy(&value, fitness + i * sizeof(double), sizeof(double));
+    this -> readGenes(genes + i * genomeBytes, individual);
+    generation.addIndividual(individual, value);
+  }
+
+  return generation;
+}
+
+/** Returns the Nth record */
+const unsigned char * RunLogReader::record(size_t N) const
+{
+  if (N >= m_size)
+    throw std::out_of_range("Run log has no record " + std::to_string(N));
+
+  // Offsets were checked when the file was mapped
+  return m_data + (m_offsets ? m_offsets[N] : sizeof(RunLogHeader) + N * m_header -> recordSize);
+}
+
+/** Converts genes of geneWidth bytes into the individual, throws std::runtime_error if a gene is out of the board */
+void RunLogReader::readGenes(const unsigned char * genes, std::vector<size_t> & individual) const
+{
+  individual.resize(m_header -> dimension);
+  for (size_t i = 0; i < individual.size(); i ++)
+  {
+    switch (m_header -> geneWidth)
+    {
+      case 1:
+        individual[i] = genes[i];
+        break;
+      case 2:
+      {
+        uint16_t gene;
+        std::memcpy(&gene, genes + 2 * i, sizeof(gene));
+        individual[i] = gene;
+        break;
+      }
+      default:
+      {
+        uint32_t gene;
+        std::memcpy(&gene, genes + 4 * i, sizeof(gene));
+        individual[i] = gene;
+      }
+    }
+
+    // Replay scores the genes, the kernels index their histograms by them
+    if (individual[i] >= individual.size())
+      throw std::runtime_error("Run log has a gene out of the board");
+  }
+}
@@ -0,0 +1,173 @@
+/**
+ * @file runLog.hpp
+ * @author Ondrej
+ * @brief Append-only binary log of a run, written in the background and read back through mmap
+ *
+*/
+
+#pragma once
+
+#include "generationHistory.hpp"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+
+#define RUN_LOG_VERSION 1
+#define RUN_LOG_FLUSH_SIZE (1 << 20) // Bytes of records collected before the writer thread is woken up
+
+class Generation;
+
+/* Layout of the file (native byte order, every part is 8 byte aligned):
+   RunLogHeader | record 0 | record 1 | ... | uint64_t offsets of the records | RunLogFooter
+   Record is RunLogRecord, best genome (dimension genes of geneWidth bytes) and, if the log keeps populations,
+   fitness of populationCapacity individuals and their genomes. Every record has the same size, so a log without
+   the footer (run that did not finish) can still be read up to its last whole record */
+
+/** Start of the file */
+struct RunLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t geneWidth;
+  uint64_t dimension;
+  // Maximal number of individuals in the record, 0 if the log keeps only the best individuals
+  uint64_t populationCapacity;
+  uint64_t seed;
+  uint64_t recordSize;
+  uint64_t reserved[2];
+};
+
+/** Fixed part of the record of one generation */
+struct RunLogRecord
+{
+  uint64_t index;
+  double bestFitness;
+  double averageFitness;
+  float mutationRate;
+  float crossoverRate;
+  // Number of individuals stored in the record (0 if the log keeps only the best individuals)
+  uint64_t populationSize;
+};
+
+/** End of the file, written when the log is closed */
+struct RunLogFooter
+{
+  uint64_t recordCount;
+  uint64_t indexOffset;
+  char magic[8];
+};
+
+/** Streams one record per generation into the file. Records are serialised into a memory buffer and written
+    by a background thread, so append never waits for the disk */
+class RunLogWriter
+{
+public:
+  /** Creates the file, throws std::runtime_error if it can not be created. If populations is true,
+      records keep whole populations, otherwise only the stats and the best individual */
+  explicit RunLogWriter(const std::string & path, bool populations = false);
+
+  /** Closes the log (errors are ignored, call close to see them) */
+  ~RunLogWriter();
+
+  RunLogWriter(const RunLogWriter &) = delete;
+  RunLogWriter & operator=(const RunLogWriter &) = delete;
+
+  /** Writes the header, has to be called once before the first append */
+  void begin(size_t dimension, size_t populationCapacity, uint64_t seed);
+
+  /** Appends record of the generation */
+  void append(Generation & generation);
+
+  /** Writes the remaining records and the footer, throws std::runtime_error if writing failed */
+  void close(void);
+
+  /** Returns number of appended records */
+  size_t size(void) const;
+
+private:
+  /** Writes the buffers handed over by append until the log is closed */
+  void writerLoop(void);
+
+  /** Stops the writer thread and writes the footer, returns false if some write failed */
+  bool finish(void);
+
+  std::string m_path;
+  std::ofstream m_file;
+  bool m_populations;
+  bool m_started = false;
+  bool m_closed = false;
+  size_t m_dimension = 0;
+  size_t m_geneWidth = 1;
+  size_t m_populationCapacity = 0;
+  size_t m_recordSize = 0;
+  std::vector<uint64_t> m_offsets;
+
+  /* Records waiting for the writer thread, the thread swaps the buffer with its own one and writes it unlocked */
+  std::vector<unsigned char> m_pending;
+  std::vector<unsigned char> m_writing;
+  bool m_stopping = false;
+  std::atomic<bool> m_failed {false};
+  std::mutex m_mtx;
+  std::condition_variable m_wake;
+  std::thread m_writer;
+};
+
+/** Read-only view of a log, the file is memory mapped, so records are read in O(1) without loading the whole log */
+class RunLogReader
+{
+public:
+  /** Maps the file, throws std::runtime_error if it is not a valid log */
+  explicit RunLogReader(const std::string & path);
+
+  ~RunLogReader();
+
+  RunLogReader(const RunLogReader &) = delete;
+  RunLogReader & operator=(const RunLogReader &) = delete;
+
+  /** Returns number of records */
+  size_t size(void) const;
+
+  /** Returns board size */
+  size_t dimension(void) const;
+
+  /** Returns seed of the logged run */
+  uint64_t seed(void) const;
+
+  /** Returns true if the records keep whole populations */
+  bool hasPopulations(void) const;
+
+  /** Returns true if the log was closed (false if the run was interrupted) */
+  bool isComplete(void) const;
+
+  /** Returns fixed part of the Nth record */
+  const RunLogRecord & getRecord(size_t N) const;
+
+  /** Returns stats and the best individual of the Nth generation */
+  GenerationSummary getSummary(size_t N) const;
+
+  /** Returns the Nth generation, whole if the log keeps populations, otherwise only its best individual */
+  Generation getGeneration(size_t N) const;
+
+private:
+  /** Checks the header and the index against the length of the file, throws std::runtime_error if they do not fit */
+  void validate(const std::string & path);
+
+  /** Returns the Nth record */
+  const unsigned char * record(size_t N) const;
+
+  /** Converts genes of geneWidth bytes into the individual, throws std::runtime_error if a gene is out of the board */
+  void readGenes(const unsigned char * genes, std::vector<size_t> & individual) const;
+
+  const unsigned char * m_data = nullptr;
+  size_t m_length = 0;
+  const RunLogHeader * m_header = nullptr;
+  const uint64_t * m_offsets = nullptr;
+  size_t m_size = 0;
+};
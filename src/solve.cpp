@@ -0,0 +1,351 @@
+/**
+ * @file solve.cpp
+ * @author Ondrej
+ * @brief Headless command line solver, runs the genetic algorithm without the visualisation
+*/
+
+#include "islandModel.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+  /** Output format of the result */
+  enum class Format
+  {
+    Human,
+    Json,
+    Csv
+  };
+
+  /** Prints usage of the solver */
+  void printUsage(const char * program)
+  {
+    std::cout << "Usage: " << program << " [N] [options]\n"
+              << "  --size N                  board size (8 by default)\n"
+              << "  --seed S                  seed, the same seed reproduces the same run (random by default)\n"
+              << "  --threads T               number of worker threads\n"
+              << "  --islands K               number of populations that evolve in parallel\n"
+              << "  --migration-interval G    generations between migrations\n"
+              << "  --migrants M              number of individuals every island sends\n"
+              << "  --topology ring|random    which island receives the migrants\n"
+              << "  --config FILE             reads the parameters below from \"key = value\" lines (e.g. population = 500)\n"
+              << "  --population P            population size\n"
+              << "  --generations G           maximal number of generations\n"
+              << "  --mutation-rate R         initial mutation rate\n"
+              << "  --crossover-rate R        initial crossover rate\n"
+              << "  --elites E                number of best individuals kept in the next generation\n"
+              << "  --elite-crossover C       number of children of the best individuals\n"
+              << "  --tournament T            tournament size\n"
+              << "  --encoding columns|permutation              representation of the individuals\n"
+              << "  --permutation-crossover pmx|ox|cycle        crossover of the permutation encoding\n"
+              << "  --permutation-mutation swap|inversion       mutation of the permutation encoding\n"
+              << "  --permutation-mutations M                   expected number of mutations of one individual\n"
+              << "  --local-search-steps S    min-conflicts moves of every elite in every generation (0, off by default)\n"
+              << "  --fitness-cache S         slots of the cache of seen genomes (power of two, 0 and off by default)\n"
+              << "  --reject-duplicates true|false              mutate copies of an individual of the same generation (needs the cache)\n"
+              << "  --log FILE                streams every generation of the first island into a binary run log\n"
+              << "  --log-mode best|full      log keeps the best individuals or whole populations (best by default)\n"
+              << "  --profile FILE            writes time and calls of the phases of every generation as JSON lines\n"
+              << "  --checkpoint FILE         saves the state of the run into the file in the background\n"
+              << "  --checkpoint-interval G   generations between checkpoints (multiple of the migration interval)\n"
+              << "  --resume FILE             continues the run saved in the checkpoint with its size, seed and parameters\n"
+              << "                            (only --threads and the output options can be combined with it)\n"
+              << "  --format human|json|csv   output format (human by default)\n"
+              << "  --help                    prints this help" << std::endl;
+  }
+
+  /** Options that do not change the run, so they can be combined with --resume */
+  const char * const RESUME_OPTIONS[] = {"--threads", "--log", "--log-mode", "--profile", "--checkpoint",
+                                         "--checkpoint-interval", "--resume", "--format"};
+
+  /** Returns true if the option only changes how the run is computed or reported */
+  bool isResumeOption(const std::string & option)
+  {
+    return std::find(std::begin(RESUME_OPTIONS), std::end(RESUME_OPTIONS), option) != std::end(RESUME_OPTIONS);
+  }
+
+  /** Parses the value of an option, throws std::invalid_argument if it is not a valid value */
+  template <typename T>
+  T parseValue(const std::string & option, const char * value)
+  {
+    T result;
+    std::istringstream parse(value);
+    if (!(parse >> result) || !parse.eof())
+      throw std::invalid_argument("Invalid value of " + option + ": " + value);
+
+    return result;
+  }
+
+  /** Prints the individual as space separated columns of the queens */
+  std::string formatIndividual(const std::vector<size_t> & individual, const char * separator)
+  {
+    std::string result;
+    for (size_t i = 0; i < individual.size(); i ++)
+    {
+      if (i != 0)
+        result += separator;
+      result += std::to_string(individual[i]);
+    }
+
+    return result;
+  }
+}
+
+/**
+ * @brief Solves N-Queens problem without opening a window
+ * - Argument 1: Positive integer N that stands for chess board size (NxN), can be passed by --size too
+ * - Options: parameters of the genetic algorithm and the island model, see --help
+*/
+int main (int argc, char ** argv)
+{
+  // Default values if no arguments are passed
+  size_t N = 8;
+  uint64_t seed = Random::randomSeed();
+  size_t threads = std::thread::hardware_concurrency();
+  size_t islands = ISLAND_COUNT;
+  size_t migrationInterval = MIGRATION_INTERVAL;
+  size_t migrants = MIGRANT_COUNT;
+  MigrationTopology topology = MigrationTopology::Ring;
+  Format format = Format::Human;
+  std::string logPath;
+  bool logPopulations = false;
+  std::string profilePath;
+  std::string checkpointPath;
+  size_t checkpointInterval = CHECKPOINT_INTERVAL;
+  std::string resumePath;
+  // First option that sets a parameter of the run, the resumed run takes all of them from the checkpoint
+  std::string runOption;
+  GeneticConfig config;
+
+  try
+  {
+    for (int i = 1; i < argc; i ++)
+    {
+      std::string option = argv[i];
+
+      if (option == "--help" || option == "-h")
+      {
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+      }
+
+      // Board size can be passed without the option
+      if (option.rfind("--", 0) != 0)
+      {
+        N = parseValue<size_t>("size", argv[i]);
+        if (runOption.empty())
+          runOption = "board size";
+        continue;
+      }
+
+      if (i + 1 >= argc)
+        throw std::invalid_argument("Missing value of " + option);
+      const char * value = argv[++ i];
+      if (runOption.empty() && !isResumeOption(option))
+        runOption = option;
+
+      if (option == "--size")
+        N = parseValue<size_t>(option, value);
+      else if (option == "--seed")
+        seed = parseValue<uint64_t>(option, value);
+      else if (option == "--threads")
+        threads = parseValue<size_t>(option, value);
+      else if (option == "--islands")
+        islands = parseValue<size_t>(option, value);
+      else if (option == "--migration-interval")
+        migrationInterval = parseValue<size_t>(option, value);
+      else if (option == "--migrants")
+        migrants = parseValue<size_t>(option, value);
+      // Options are applied in order, so flags after --config override the file
+      else if (option == "--config")
+        config.load(value);
+      else if (option == "--topology")
+      {
+        if (std::strcmp(value, "ring") == 0)
+          topology = MigrationTopology::Ring;
+        else if (std::strcmp(value, "random") == 0)
+          topology = MigrationTopology::Random;
+        else
+          throw std::invalid_argument(std::string("Unknown topology: ") + value);
+      }
+      else if (option == "--log")
+        logPath = value;
+      else if (option == "--log-mode")
+      {
+        if (std::strcmp(value, "best") == 0)
+          logPopulations = false;
+        else if (std::strcmp(value, "full") == 0)
+          logPopulations = true;
+        else
+          throw std::invalid_argument(std::string("Unknown log mode: ") + value);
+      }
+      else if (option == "--profile")
+      {
+        if (!NQUEENS_PROFILE)
+          throw std::invalid_argument("Profiling was compiled out, build with make PROFILE=1");
+        profilePath = value;
+      }
+      else if (option == "--checkpoint")
+        checkpointPath = value;
+      else if (option == "--checkpoint-interval")
+        checkpointInterval = parseValue<size_t>(option, value);
+      else if (option == "--resume")
+        resumePath = value;
+      else if (option == "--format")
+      {
+        if (std::strcmp(value, "human") == 0)
+          format = Format::Human;
+        else if (std::strcmp(value, "json") == 0)
+          format = Format::Json;
+        else if (std::strcmp(value, "csv") == 0)
+          format = Format::Csv;
+        else
+          throw std::invalid_argument(std::string("Unknown format: ") + value);
+      }
+      else if (!config.set(option.substr(2), value))
+        throw std::invalid_argument("Unknown option: " + option);
+    }
+
+    if (!resumePath.empty() && !runOption.empty())
+      throw std::invalid_argument("Resumed run keeps the parameters of its checkpoint, " + runOption +
+                                  " can not be combined with --resume");
+
+    if (N == 0 || islands == 0)
+      throw std::invalid_argument("Board size and number of islands must be positive");
+
+    if (islands > ISLAND_LIMIT)
+      throw std::invalid_argument("Number of islands must not exceed " + std::to_string(ISLAND_LIMIT));
+
+    config.validate();
+  }
+  catch (const std::invalid_argument & error)
+  {
+    std::cerr << error.what() << std::endl;
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  /* Runs the island model and measures the wall time, resumed run takes the board size, seed and parameters
+     from the checkpoint */
+  std::unique_ptr<IslandModel> model;
+  std::unique_ptr<RunLogWriter> log;
+  std::unique_ptr<CheckpointWriter> checkpoint;
+  try
+  {
+    if (resumePath.empty())
+      model = std::make_unique<IslandModel>(N, seed, islands, migrationInterval, migrants, topology, threads, config);
+    else
+    {
+      model = IslandModel::fromCheckpoint(resumePath, threads);
+      N = model -> getDimension();
+      seed = model -> getSeed();
+    }
+
+    if (!logPath.empty())
+    {
+      log = std::make_unique<RunLogWriter>(logPath, logPopulations);
+      model -> getIsland(0).setRunLog(log.get());
+    }
+
+    if (!checkpointPath.empty())
+    {
+      checkpoint = std::make_unique<CheckpointWriter>(checkpointPath);
+      model -> setCheckpoint(checkpoint.get(), checkpointInterval);
+    }
+  }
+  catch (const std::exception & error)
+  {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  bool solved = model -> solve();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  /* Log and checkpoint are closed after the timing, the remaining data is written by their threads in the meantime */
+  try
+  {
+    if (log)
+      log -> close();
+    if (checkpoint)
+      checkpoint -> close();
+  }
+  catch (const std::runtime_error & error)
+  {
+    std::cerr << error.what() << std::endl;
+  }
+
+  /* Profiles are written after the run, one line per generation of every island */
+  if (!profilePath.empty())
+  {
+    std::ofstream profile(profilePath);
+    for (size_t i = 0; i < model -> getIslandCount(); i ++)
+    {
+      Genetic & island = model -> getIsland(i);
+      for (size_t generation = 0; generation < island.getProfilesCount(); generation ++)
+        profile << island.getProfile(generation).toJson(i) << "\n";
+    }
+
+    if (!profile)
+      std::cerr << "Can not write the profile to " << profilePath << std::endl;
+  }
+
+  /* Solution is the best individual of the last generation of the solved (or the best) island */
+  size_t generations = model -> getGenerationsCount();
+  size_t island = solved ? model -> getSolvedIsland() : model -> getBestIsland(generations - 1);
+  Genetic & genetic = model -> getIsland(island);
+  const GenerationSummary & last = genetic.getNthSummary(genetic.getGenerationsCount() - 1);
+
+  size_t evaluations = model -> getEvaluationsCount();
+  double evaluationsPerSecond = seconds > 0 ? evaluations / seconds : 0;
+  FitnessCacheStats cache = model -> getCacheStats();
+
+  switch (format)
+  {
+    case Format::Human:
+      std::cout << (solved ? "Success" : "Failure") << "\n"
+                << "Solution: " << formatIndividual(last.bestIndividual, " ") << "\n"
+                << "Fitness: " << last.bestFitness << "\n"
+                << "Generations: " << generations << "\n"
+                << "Time: " << seconds << " s\n"
+                << "Evaluations: " << evaluations << "\n"
+                << "Evaluations/s: " << evaluationsPerSecond << std::endl;
+      // The cache is off by default, it has no lookups then
+      if (cache.lookups != 0)
+      {
+        std::cout << "Cache hit rate: " << cache.hitRate() * 100 << " % (" << cache.hits << " hits, "
+                  << cache.duplicates << " duplicates, " << cache.rejected << " rejected)" << std::endl;
+      }
+      break;
+    case Format::Json:
+      std::cout << "{\"n\":" << N << ",\"seed\":" << seed << ",\"solved\":" << (solved ? "true" : "false")
+                << ",\"generations\":" << generations << ",\"fitness\":" << last.bestFitness
+                << ",\"seconds\":" << seconds << ",\"evaluations\":" << evaluations
+                << ",\"evaluations_per_second\":" << evaluationsPerSecond
+                << ",\"cache_lookups\":" << cache.lookups << ",\"cache_hits\":" << cache.hits
+                << ",\"cache_duplicates\":" << cache.duplicates << ",\"cache_rejected\":" << cache.rejected
+                << ",\"solution\":[" << formatIndividual(last.bestIndividual, ",") << "]}" << std::endl;
+      break;
+    case Format::Csv:
+      std::cout << "n,seed,solved,generations,fitness,seconds,evaluations,evaluations_per_second,"
+                << "cache_lookups,cache_hits,cache_duplicates,cache_rejected,solution\n"
+                << N << "," << seed << "," << solved << "," << generations << "," << last.bestFitness << ","
+                << seconds << "," << evaluations << "," << evaluationsPerSecond << "," << cache.lookups << ","
+                << cache.hits << "," << cache.duplicates << "," << cache.rejected << ","
+                << formatIndividual(last.bestIndividual, " ") << std::endl;
+      break;
+  }
+
+  return solved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
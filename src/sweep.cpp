@@ -0,0 +1,613 @@
+/**
+ * @file sweep.cpp
+ * @author Ondrej
+ * @brief Parameter sweep, runs the genetic algorithm for a grid (or random samples) of parameters and seeds in parallel
+*/
+
+#include "geneticAlgorithm.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+extern char ** environ;
+
+#define SWEEP_SEEDS 5 // Runs of every configuration (each with its own seed)
+#define SWEEP_SAMPLES 20 // Configurations drawn by the random search
+#define SWEEP_SEED 1 // Seeds of the runs and of the random search are derived from it
+#define SWEEP_SOLVER "nqueens-solve" // Program that computes the runs, it is looked up next to the sweep
+
+namespace
+{
+  /** Values of one parameter: a list of values or, in the random search, a range [low, high] */
+  struct Parameter
+  {
+    std::string key;
+    std::vector<std::string> values;
+    bool range = false;
+    // Range is sampled as whole numbers if both bounds are whole numbers
+    bool integral = false;
+    double low = 0;
+    double high = 0;
+  };
+
+  /** One configuration of the sweep, values follow the order of the parameters */
+  struct Configuration
+  {
+    size_t N = 8;
+    GeneticConfig config;
+    std::vector<std::string> values;
+  };
+
+  /** Result of one run, parsed from the CSV row of the solver */
+  struct Outcome
+  {
+    bool failed = false;
+    bool solved = false;
+    size_t generations = 0;
+    double seconds = 0;
+    size_t evaluations = 0;
+    std::string error;
+  };
+
+  /** Options of the sweep */
+  struct Options
+  {
+    std::vector<Parameter> parameters;
+    bool random = false;
+    size_t samples = SWEEP_SAMPLES;
+    size_t seeds = SWEEP_SEEDS;
+    uint64_t seed = SWEEP_SEED;
+    size_t jobs = std::thread::hardware_concurrency();
+    size_t threads = 1;
+    std::string output;
+    std::string solver = SWEEP_SOLVER;
+  };
+
+  /** Removes whitespace around the text */
+  std::string trim(const std::string & text)
+  {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+      return "";
+
+    return text.substr(begin, text.find_last_not_of(" \t\r") + 1 - begin);
+  }
+
+  /** Parses a number, throws std::invalid_argument if it is not one */
+  double parseNumber(const std::string & option, const std::string & value)
+  {
+    std::istringstream parse(value);
+    double number;
+    if (!(parse >> number) || !parse.eof())
+      throw std::invalid_argument("Invalid value of " + option + ": " + value);
+
+    return number;
+  }
+
+  /** Parses "key = v1, v2, ..." or "key = low..high" into the parameter, the key has to be "size" or a parameter
+      of GeneticConfig, every value of a list is checked by GeneticConfig::set */
+  Parameter parseParameter(const std::string & line)
+  {
+    size_t separator = line.find('=');
+    if (separator == std::string::npos)
+      throw std::invalid_argument("Missing = in " + line);
+
+    Parameter parameter;
+    parameter.key = trim(line.substr(0, separator));
+    std::string values = trim(line.substr(separator + 1));
+
+    size_t dots = values.find("..");
+    if (dots != std::string::npos)
+    {
+      std::string low = trim(values.substr(0, dots));
+      std::string high = trim(values.substr(dots + 2));
+      parameter.range = true;
+      parameter.low = parseNumber(parameter.key, low);
+      parameter.high = parseNumber(parameter.key, high);
+      parameter.integral = low.find_first_of(".eE") == std::string::npos && high.find_first_of(".eE") == std::string::npos;
+      if (parameter.low > parameter.high)
+        throw std::invalid_argument("Empty range of " + parameter.key + ": " + values);
+      parameter.values = {low, high};
+    }
+    else
+    {
+      std::istringstream parse(values);
+      std::string value;
+      while (std::getline(parse, value, ','))
+        parameter.values.push_back(trim(value));
+    }
+
+    if (parameter.values.empty())
+      throw std::invalid_argument("Missing values of " + parameter.key);
+
+    /* Values are set on a scratch config, so a typo is reported before the first run */
+    GeneticConfig config;
+    for (const std::string & value: parameter.values)
+    {
+      if (parameter.key == "size")
+      {
+        if (parseNumber(parameter.key, value) < 1)
+          throw std::invalid_argument("Board size must be positive");
+      }
+      else if (!config.set(parameter.key, value))
+        throw std::invalid_argument("Unknown parameter " + parameter.key);
+    }
+
+    return parameter;
+  }
+
+  /** Reads parameters from the spec file, one "key = values" line per parameter (# starts a comment) */
+  void loadSpec(const std::string & path, std::vector<Parameter> & parameters)
+  {
+    std::ifstream file(path);
+    if (!file)
+      throw std::invalid_argument("Can not open spec file " + path);
+
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); lineNumber ++)
+    {
+      line = line.substr(0, line.find('#'));
+      if (trim(line).empty())
+        continue;
+
+      try
+      {
+        parameters.push_back(parseParameter(line));
+      }
+      catch (const std::invalid_argument & error)
+      {
+        throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": " + error.what());
+      }
+    }
+  }
+
+  /** Quotes the CSV field if it contains a separator, a quote or a line break (quotes in it are doubled) */
+  std::string csvField(const std::string & text)
+  {
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+      return text;
+
+    std::string quoted = "\"";
+    for (char character: text)
+    {
+      if (character == '"')
+        quoted += '"';
+      quoted += character;
+    }
+
+    return quoted + "\"";
+  }
+
+  /** Applies the values to a configuration, returns false and the reason if the parameters can not be used together */
+  bool makeConfiguration(const std::vector<Parameter> & parameters, const std::vector<std::string> & values,
+                         Configuration & configuration, std::string & reason)
+  {
+    configuration.values = values;
+    for (size_t i = 0; i < parameters.size(); i ++)
+    {
+      if (parameters[i].key == "size")
+        configuration.N = static_cast<size_t>(parseNumber("size", values[i]));
+      else
+        configuration.config.set(parameters[i].key, values[i]);
+    }
+
+    try
+    {
+      configuration.config.validate();
+    }
+    catch (const std::invalid_argument & error)
+    {
+      reason = error.what();
+      return false;
+    }
+
+    return true;
+  }
+
+  /** Returns all combinations of the values (cartesian product) */
+  std::vector<Configuration> gridConfigurations(const std::vector<Parameter> & parameters)
+  {
+    std::vector<Configuration> configurations;
+    std::vector<size_t> digits(parameters.size(), 0);
+    while (true)
+    {
+      std::vector<std::string> values;
+      for (size_t i = 0; i < parameters.size(); i ++)
+        values.push_back(parameters[i].values[digits[i]]);
+
+      Configuration configuration;
+      std::string reason;
+      if (makeConfiguration(parameters, values, configuration, reason))
+        configurations.push_back(configuration);
+      else
+      {
+        std::cerr << "Skipping configuration:";
+        for (size_t i = 0; i < parameters.size(); i ++)
+          std::cerr << " " << parameters[i].key << "=" << values[i];
+        std::cerr << " (" << reason << ")" << std::endl;
+      }
+
+      // Next combination, the last parameter changes the fastest
+      size_t i = parameters.size();
+      for (; i > 0; i --)
+      {
+        if (++ digits[i - 1] < parameters[i - 1].values.size())
+          break;
+        digits[i - 1] = 0;
+      }
+
+      if (i == 0)
+        break;
+    }
+
+    return configurations;
+  }
+
+  /** Returns samples configurations with values drawn uniformly from the lists and ranges */
+  std::vector<Configuration> randomConfigurations(const std::vector<Parameter> & parameters, size_t samples, uint64_t seed)
+  {
+    Random random(Random::mix(seed));
+    std::vector<Configuration> configurations;
+    size_t skipped = 0;
+    std::string firstReason;
+
+    // Draws that can not be used are skipped, but a spec without any usable combination has to end too
+    for (size_t draw = 0; configurations.size() < samples && draw < 100 * samples; draw ++)
+    {
+      std::vector<std::string> values;
+      for (const Parameter & parameter: parameters)
+      {
+        if (!parameter.range)
+        {
+          values.push_back(parameter.values[random.bounded(parameter.values.size())]);
+          continue;
+        }
+
+        std::ostringstream value;
+        if (parameter.integral)
+          value << static_cast<long long>(parameter.low) + static_cast<long long>(random.bounded(parameter.high - parameter.low + 1));
+        else
+          value << std::setprecision(6) << parameter.low + random.uniform() * (parameter.high - parameter.low);
+        values.push_back(value.str());
+      }
+
+      Configuration configuration;
+      std::string reason;
+      if (makeConfiguration(parameters, values, configuration, reason))
+        configurations.push_back(configuration);
+      else if (skipped ++ == 0)
+        firstReason = reason;
+    }
+
+    // Draws are not listed one by one, a narrow spec can reject hundreds of them
+    if (skipped != 0)
+      std::cerr << "Skipped " << skipped << " drawn configurations that can not be used (e.g. " << firstReason << ")" << std::endl;
+
+    return configurations;
+  }
+
+  /** Parses the CSV output of the solver into the outcome, returns false if it has no result row */
+  bool parseSolverOutput(const std::string & output, Outcome & outcome)
+  {
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      // Row follows the header: n,seed,solved,generations,fitness,seconds,evaluations,...
+      if (line.rfind("n,seed,solved,", 0) != 0 || !std::getline(lines, line))
+        continue;
+
+      std::vector<std::string> fields;
+      std::istringstream row(line);
+      for (std::string field; std::getline(row, field, ',');)
+        fields.push_back(field);
+
+      if (fields.size() < 7)
+        return false;
+
+      try
+      {
+        outcome.solved = fields[2] == "1";
+        outcome.generations = std::stoull(fields[3]);
+        outcome.seconds = std::stod(fields[5]);
+        outcome.evaluations = std::stoull(fields[6]);
+      }
+      catch (const std::exception &)
+      {
+        return false;
+      }
+
+      return true;
+    }
+
+    return false;
+  }
+
+  /** Runs the configuration with the seed by the solver in its own process, so the peak memory of every run is
+      measured alone (and a crash of one run does not end the sweep). The process is spawned, not forked, because
+      the runs are started from the threads of the pool. Peak resident size of the child is stored into peakKib */
+  Outcome executeRun(const std::vector<Parameter> & parameters, const Configuration & configuration, uint64_t seed,
+                     const Options & options, long & peakKib)
+  {
+    Outcome outcome;
+    peakKib = 0;
+
+    /* One island is the plain genetic algorithm, its first island runs with the seed itself */
+    std::vector<std::string> arguments = {options.solver, std::to_string(configuration.N), "--seed", std::to_string(seed),
+                                          "--threads", std::to_string(options.threads), "--islands", "1", "--format", "csv"};
+    for (size_t i = 0; i < parameters.size(); i ++)
+    {
+      if (parameters[i].key == "size")
+        continue;
+      arguments.push_back("--" + parameters[i].key);
+      arguments.push_back(configuration.values[i]);
+    }
+
+    std::vector<char *> argv;
+    for (std::string & argument: arguments)
+      argv.push_back(argument.data());
+    argv.push_back(nullptr);
+
+    // Close-on-exec, so runs spawned by the other threads at the same time do not inherit the write end
+    int pipeEnds[2];
+    if (pipe2(pipeEnds, O_CLOEXEC) != 0)
+    {
+      outcome.failed = true;
+      outcome.error = "Can not create pipe";
+      return outcome;
+    }
+
+    /* Both outputs of the solver go into the pipe, its errors are reported by the row of the run */
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipeEnds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipeEnds[1], STDERR_FILENO);
+
+    pid_t child;
+    int error = posix_spawnp(&child, options.solver.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipeEnds[1]);
+    if (error != 0)
+    {
+      close(pipeEnds[0]);
+      outcome.failed = true;
+      outcome.error = "Can not start " + options.solver + ": " + std::strerror(error);
+      return outcome;
+    }
+
+    std::string output;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(pipeEnds[0], buffer, sizeof(buffer))) > 0)
+      output.append(buffer, count);
+    close(pipeEnds[0]);
+
+    int status = 0;
+    struct rusage usage {};
+    wait4(child, &status, 0, &usage);
+    peakKib = usage.ru_maxrss;
+
+    // Solver exits with a failure for an unsolved board too, so only the missing row is an error
+    if (!parseSolverOutput(output, outcome))
+    {
+      outcome = Outcome();
+      outcome.failed = true;
+      if (WIFSIGNALED(status))
+        outcome.error = strsignal(WTERMSIG(status));
+      else if (!output.empty())
+        outcome.error = output.substr(0, output.find('\n'));
+      else
+        outcome.error = "Run ended without a result";
+    }
+
+    return outcome;
+  }
+
+  /** Prints usage of the sweep */
+  void printUsage(const char * program)
+  {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --spec FILE               reads \"key = values\" lines, values are a list (v1, v2, ...) or, in the\n"
+              << "                            random search, a range (low..high), keys are size (board size) and the\n"
+              << "                            parameters of nqueens-solve without -- (e.g. mutation-rate, tournament)\n"
+              << "  --param \"key = values\"    adds one parameter like a line of the spec\n"
+              << "  --mode grid|random        all combinations of the lists or random samples (grid by default)\n"
+              << "  --samples K               configurations drawn by the random search" << " (" << SWEEP_SAMPLES << " by default)\n"
+              << "  --seeds R                 runs of every configuration, every configuration gets the same seeds" << " (" << SWEEP_SEEDS << " by default)\n"
+              << "  --seed S                  seed of the run seeds and of the random search" << " (" << SWEEP_SEED << " by default)\n"
+              << "  --jobs J                  runs computed at the same time (number of cores by default)\n"
+              << "  --threads T               worker threads of one run (1 by default)\n"
+              << "  --output FILE             writes the CSV into the file instead of the standard output\n"
+              << "  --solver FILE             program that computes the runs (" << SWEEP_SOLVER << " next to the sweep by default)\n"
+              << "  --help                    prints this help" << std::endl;
+  }
+
+  /** Parses positive whole number */
+  size_t parseCount(const std::string & option, const char * value)
+  {
+    std::istringstream parse(value);
+    size_t number;
+    if (!(parse >> number) || !parse.eof() || number == 0)
+      throw std::invalid_argument("Invalid value of " + option + ": " + value);
+
+    return number;
+  }
+}
+
+/**
+ * @brief Runs every configuration of the sweep with several seeds and writes one CSV row per run
+ * - Runs are independent nqueens-solve processes started by a pool of jobs, rows are written as the runs finish
+ * - The best configuration of every board size (most solved runs, then the shortest mean time) is printed at the end
+*/
+int main (int argc, char ** argv)
+{
+  Options options;
+
+  // Solver is built next to the sweep
+  std::string program = argv[0];
+  if (program.find('/') != std::string::npos)
+    options.solver = program.substr(0, program.rfind('/') + 1) + SWEEP_SOLVER;
+
+  try
+  {
+    for (int i = 1; i < argc; i ++)
+    {
+      std::string option = argv[i];
+      if (option == "--help" || option == "-h")
+      {
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+      }
+
+      if (i + 1 >= argc)
+        throw std::invalid_argument("Missing value of " + option);
+      const char * value = argv[++ i];
+
+      if (option == "--spec")
+        loadSpec(value, options.parameters);
+      else if (option == "--param")
+        options.parameters.push_back(parseParameter(value));
+      else if (option == "--mode")
+      {
+        if (std::strcmp(value, "grid") == 0)
+          options.random = false;
+        else if (std::strcmp(value, "random") == 0)
+          options.random = true;
+        else
+          throw std::invalid_argument(std::string("Unknown mode: ") + value);
+      }
+      else if (option == "--samples")
+        options.samples = parseCount(option, value);
+      else if (option == "--seeds")
+        options.seeds = parseCount(option, value);
+      else if (option == "--seed")
+        options.seed = parseCount(option, value);
+      else if (option == "--jobs")
+        options.jobs = parseCount(option, value);
+      else if (option == "--threads")
+        options.threads = parseCount(option, value);
+      else if (option == "--output")
+        options.output = value;
+      else if (option == "--solver")
+        options.solver = value;
+      else
+        throw std::invalid_argument("Unknown option: " + option);
+    }
+
+    if (options.parameters.empty())
+      throw std::invalid_argument("Nothing to sweep, pass --spec or --param");
+
+    for (const Parameter & parameter: options.parameters)
+    {
+      if (parameter.range && !options.random)
+        throw std::invalid_argument("Range of " + parameter.key + " needs --mode random");
+    }
+  }
+  catch (const std::invalid_argument & error)
+  {
+    std::cerr << error.what() << std::endl;
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Configuration> configurations = options.random
+    ? randomConfigurations(options.parameters, options.samples, options.seed)
+    : gridConfigurations(options.parameters);
+
+  std::ofstream file;
+  if (!options.output.empty())
+  {
+    file.open(options.output);
+    if (!file)
+    {
+      std::cerr << "Can not create " << options.output << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream & csv = options.output.empty() ? std::cout : file;
+
+  /* Board size has its own column, the other parameters follow in the order of the spec */
+  csv << "run,configuration,n,seed";
+  for (const Parameter & parameter: options.parameters)
+  {
+    if (parameter.key != "size")
+      csv << "," << parameter.key;
+  }
+  csv << ",solved,generations,seconds,evaluations,peak_rss_kib,error" << std::endl;
+
+  /* Every configuration runs with the same seeds, so configurations are compared on the same random streams */
+  const size_t runs = configurations.size() * options.seeds;
+  std::vector<Outcome> outcomes(runs);
+  std::mutex outputMutex;
+
+  ThreadPool pool(std::min(options.jobs, std::max<size_t>(runs, 1)));
+  pool.parallelFor(runs, [&] (size_t run, size_t)
+  {
+    const Configuration & configuration = configurations[run / options.seeds];
+    uint64_t seed = Random::mix(options.seed + run % options.seeds);
+
+    long peakKib;
+    Outcome outcome = executeRun(options.parameters, configuration, seed, options, peakKib);
+    outcomes[run] = outcome;
+
+    std::ostringstream row;
+    row << run << "," << run / options.seeds << "," << configuration.N << "," << seed;
+    for (size_t i = 0; i < options.parameters.size(); i ++)
+    {
+      if (options.parameters[i].key != "size")
+        row << "," << configuration.values[i];
+    }
+    row << "," << outcome.solved << "," << outcome.generations << "," << outcome.seconds << "," << outcome.evaluations
+        << "," << peakKib << "," << csvField(outcome.error);
+
+    std::unique_lock<std::mutex> lock (outputMutex);
+    csv << row.str() << std::endl;
+  });
+
+  /* Best configuration of every board size */
+  std::map<size_t, std::pair<size_t, double>> best;
+  std::map<size_t, size_t> bestConfiguration;
+  for (size_t i = 0; i < configurations.size(); i ++)
+  {
+    size_t solved = 0;
+    double seconds = 0;
+    for (size_t run = i * options.seeds; run < (i + 1) * options.seeds; run ++)
+    {
+      solved += outcomes[run].solved;
+      seconds += outcomes[run].seconds / options.seeds;
+    }
+
+    size_t N = configurations[i].N;
+    auto found = best.find(N);
+    if (found == best.end() || solved > found -> second.first || (solved == found -> second.first && seconds < found -> second.second))
+    {
+      best[N] = {solved, seconds};
+      bestConfiguration[N] = i;
+    }
+  }
+
+  for (const auto & [N, result]: best)
+  {
+    const Configuration & configuration = configurations[bestConfiguration[N]];
+    std::cerr << "Best for N = " << N << ": configuration " << bestConfiguration[N];
+    for (size_t i = 0; i < options.parameters.size(); i ++)
+    {
+      if (options.parameters[i].key != "size")
+        std::cerr << " " << options.parameters[i].key << "=" << configuration.values[i];
+    }
+    std::cerr << ", solved " << result.first << "/" << options.seeds << ", mean " << result.second << " s" << std::endl;
+  }
+
+  return csv ? EXIT_SUCCESS : EXIT_FAILURE;
+}
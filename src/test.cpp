@@ -0,0 +1,478 @@
+/**
+ * @file test.cpp
+ * @author Ondrej
+ * @brief Checks the conflict counter and the fitness kernels against the pairwise attackCount definition, the
+ *        operators of the permutation encoding, the batch evaluator of every instruction set against the counter
+ *        and the run log reader against corrupt logs
+*/
+
+#include "geneticAlgorithm.hpp"
+#include "runLog.hpp"
+#include "batchFitness.hpp"
+#include "permutation.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+
+#define TEST_MAX_SIZE 140 // Boards 1..TEST_MAX_SIZE are checked
+#define TEST_RANDOM_BOARDS 20 // Random boards of every size
+#define TEST_MOVES 50 // Random queen moves checked on every random board
+#define TEST_SEED 1 // Boards are generated from a fixed seed, so a failure can be reproduced
+#define TEST_PERMUTATION_SIZES {1, 2, 3, 4, 5, 8, 13, 32, 100, 257} // Board sizes of the permutation encoding checks
+#define TEST_PERMUTATION_PAIRS 30 // Random parents of every size and every pair of operators
+#define TEST_SEGMENT_SIZE 7 // Crossovers of boards up to this size are checked with every segment
+#define TEST_BATCH_BOARDS (2 * EVALUATION_BLOCK + 3) // Boards of every size scored by the batch evaluator, the last block is partial
+#define TEST_LOG_PATH "nqueens-test.log" // Run log written and corrupted by the test, removed afterwards
+#define TEST_LOG_CORRUPTIONS 2000 // Random byte changes of the run log
+
+namespace
+{
+  size_t failures = 0;
+
+  /** Reports a failed check */
+  void fail(const std::string & what, const std::vector<size_t> & board, size_t expected, size_t actual)
+  {
+    if (failures ++ < 20)
+    {
+      std::cerr << "FAIL " << what << " N=" << board.size() << ": expected " << expected << ", got " << actual
+                << std::endl;
+    }
+  }
+
+  /** Reports a failed check without numbers */
+  void fail(const std::string & what)
+  {
+    if (failures ++ < 20)
+      std::cerr << "FAIL " << what << std::endl;
+  }
+
+  /** Returns number of attacking pairs by the old evaluator (attackCount summed over the rows) */
+  size_t reference(Generation & generation, std::vector<size_t> & board)
+  {
+    size_t attacks = 0;
+    for (size_t row = 0; row < board.size(); row ++)
+      attacks += generation.attackCount(row, board);
+
+    return attacks;
+  }
+
+  /** Checks the counter, getFitness and the deltas of moving queens on the board */
+  void checkBoard(const std::string & name, std::vector<size_t> board, Random & random, size_t moves)
+  {
+    Generation generation(0, 0, 0);
+    const size_t N = board.size();
+    size_t expected = reference(generation, board);
+
+    ConflictCounter counter(board);
+    if (counter.conflicts() != expected)
+      fail(name + " ConflictCounter::conflicts", board, expected, counter.conflicts());
+    if (generation.getFitness(board) != expected)
+      fail(name + " Generation::getFitness", board, expected, generation.getFitness(board));
+
+    /* removeQueen and addQueen return the change of the conflicts, so the counter follows the moved queens */
+    for (size_t i = 0; i < moves; i ++)
+    {
+      size_t row = random.bounded(N);
+      size_t column = random.bounded(N);
+
+      size_t before = counter.conflicts();
+      size_t removed = counter.removeQueen(row, board[row]);
+      size_t added = counter.addQueen(row, column);
+      board[row] = column;
+      expected = reference(generation, board);
+
+      if (before - removed + added != expected)
+        fail(name + " removeQueen/addQueen delta", board, expected, before - removed + added);
+      if (counter.conflicts() != expected)
+        fail(name + " conflicts after move", board, expected, counter.conflicts());
+    }
+
+    if (ConflictCounter(board).hash() != counter.hash())
+      fail(name + " hash after moves", board, ConflictCounter(board).hash(), counter.hash());
+  }
+  /** Returns true if the individual uses every column exactly once */
+  bool isPermutation(const std::vector<size_t> & individual)
+  {
+    std::vector<size_t> sorted = individual;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); i ++)
+    {
+      if (sorted[i] != i)
+        return false;
+    }
+
+    return true;
+  }
+
+  /** Checks that the child is a permutation and that its counter, updated incrementally, matches the pairwise
+      evaluator and a counter rebuilt from the genes */
+  void checkChild(const std::string & name, Generation & generation, std::vector<size_t> & child,
+                  const ConflictCounter & counter)
+  {
+    if (!isPermutation(child))
+    {
+      fail(name + " is not a permutation (N=" + std::to_string(child.size()) + ")");
+      return;
+    }
+
+    size_t expected = reference(generation, child);
+    if (counter.conflicts() != expected)
+      fail(name + " conflicts", child, expected, counter.conflicts());
+    if (ConflictCounter(child).hash() != counter.hash())
+      fail(name + " hash", child, ConflictCounter(child).hash(), counter.hash());
+  }
+
+  /** Checks the operators of the permutation encoding on random parents: PMX, OX and cycle crossover and swap and
+      inversion mutation have to keep the individuals permutations and the counters exact, and the cycle crossover
+      has to keep every gene on the position it has in one of the parents */
+  void checkPermutations(Random & random, size_t & pairs)
+  {
+    Generation generation(0, 0, 0);
+    const PermutationCrossover crossovers[] = {PermutationCrossover::PMX, PermutationCrossover::OX, PermutationCrossover::Cycle};
+    const PermutationMutation mutations[] = {PermutationMutation::Swap, PermutationMutation::Inversion};
+    const char * crossoverNames[] = {"PMX", "OX", "cycle"};
+    const char * mutationNames[] = {"swap", "inversion"};
+
+    for (size_t N: TEST_PERMUTATION_SIZES)
+    {
+      for (size_t c = 0; c < 3; c ++)
+      {
+        for (size_t m = 0; m < 2; m ++)
+        {
+          /* Every crossover happens and every individual gets a few mutations, hashes are kept like with the cache */
+          GeneticConfig config;
+          config.encoding = Encoding::Permutation;
+          config.permutationCrossover = crossovers[c];
+          config.permutationMutation = mutations[m];
+          config.crossoverRate = 1;
+          config.mutationRate = 1;
+          config.permutationMutations = 3;
+          config.fitnessCacheSize = 1 << 10;
+          Genetic genetic(N, TEST_SEED, 1, config);
+          const std::string name = std::string(crossoverNames[c]) + "/" + mutationNames[m];
+
+          for (size_t pair = 0; pair < TEST_PERMUTATION_PAIRS; pair ++)
+          {
+            std::vector<size_t> parent1, parent2;
+            genetic.generateIndividual(parent1, random);
+            genetic.generateIndividual(parent2, random);
+
+            std::pair<std::vector<size_t>, std::vector<size_t>> children;
+            std::pair<ConflictCounter, ConflictCounter> counters;
+            genetic.crossoverIndividuals(parent1, ConflictCounter(parent1), parent2, ConflictCounter(parent2), children,
+                                         counters, random);
+            checkChild(name + " crossover child", generation, children.first, counters.first);
+            checkChild(name + " crossover child", generation, children.second, counters.second);
+
+            if (crossovers[c] == PermutationCrossover::Cycle)
+            {
+              for (size_t i = 0; i < N; i ++)
+              {
+                if ((children.first[i] != parent1[i] && children.first[i] != parent2[i])
+                    || (children.second[i] != parent1[i] && children.second[i] != parent2[i]))
+                  fail(name + " child has a gene on a position of neither parent", children.first, i, children.first[i]);
+              }
+            }
+
+            genetic.mutateIndividual(children.first, counters.first, random);
+            genetic.mutateIndividual(children.second, counters.second, random);
+            checkChild(name + " mutated child", generation, children.first, counters.first);
+            checkChild(name + " mutated child", generation, children.second, counters.second);
+            pairs ++;
+          }
+        }
+      }
+    }
+
+    /* Small boards are crossed over with every segment [begin, end) */
+    for (size_t N = 1; N <= TEST_SEGMENT_SIZE; N ++)
+    {
+      std::vector<size_t> parent1, parent2, child1, child2;
+      randomPermutation(parent1, N, random);
+      randomPermutation(parent2, N, random);
+      for (size_t begin = 0; begin < N; begin ++)
+      {
+        for (size_t end = begin + 1; end <= N; end ++)
+        {
+          pmxCrossover(parent1, parent2, begin, end, child1, child2);
+          if (!isPermutation(child1) || !isPermutation(child2))
+            fail("PMX segment [" + std::to_string(begin) + ", " + std::to_string(end) + ") of N=" + std::to_string(N));
+
+          oxCrossover(parent1, parent2, begin, end, child1, child2);
+          if (!isPermutation(child1) || !isPermutation(child2))
+            fail("OX segment [" + std::to_string(begin) + ", " + std::to_string(end) + ") of N=" + std::to_string(N));
+        }
+      }
+
+      cycleCrossover(parent1, parent2, child1, child2);
+      if (!isPermutation(child1) || !isPermutation(child2))
+        fail("cycle crossover of N=" + std::to_string(N));
+    }
+  }
+
+  /** Scores the boards by evaluateConflicts and Generation::evaluate with the instruction set and compares them with
+      the conflict counter, ranges start and end at odd indexes, so the paired AVX2 kernel gets an unpaired board */
+  void checkBatch(const std::vector<std::vector<size_t>> & boards, FitnessIsa isa)
+  {
+    const std::string name = std::string(fitnessIsaName(isa)) + " ";
+    Population population(boards.front().size());
+    Generation generation(0, 0, 0);
+    for (const std::vector<size_t> & board: boards)
+    {
+      population.push(board, -1);
+      generation.addIndividual(board, -1);
+    }
+
+    for (size_t begin: {size_t(0), size_t(1), size_t(3)})
+    {
+      for (size_t end = begin + 1; end <= boards.size(); end += end < begin + 8 ? 1 : EVALUATION_BLOCK - 1)
+      {
+        std::vector<double> fitness(end - begin, -1);
+        evaluateConflicts(population, begin, end, fitness.data(), isa);
+        for (size_t i = begin; i < end; i ++)
+        {
+          size_t expected = ConflictCounter(boards[i]).conflicts();
+          if (fitness[i - begin] != expected)
+            fail(name + "evaluateConflicts [" + std::to_string(begin) + ", " + std::to_string(end) + ")", boards[i],
+                 expected, fitness[i - begin]);
+        }
+      }
+    }
+
+    generation.evaluate(nullptr, isa);
+    for (size_t i = 0; i < boards.size(); i ++)
+    {
+      size_t expected = ConflictCounter(boards[i]).conflicts();
+      if (generation.getIndividualFitness(i) != expected)
+        fail(name + "Generation::evaluate", boards[i], expected, generation.getIndividualFitness(i));
+    }
+  }
+
+  /** Checks the batch evaluator with every instruction set the CPU supports on every board size the vectorised
+      kernels take and a few more, and on boards of two and four byte genes */
+  void checkBatches(Random & random, size_t & boards)
+  {
+    std::vector<size_t> sizes;
+    for (size_t N = 1; N <= BATCH_SIMD_MAX_DIMENSION + 4; N ++)
+      sizes.push_back(N);
+    sizes.push_back(256);
+    sizes.push_back(257);
+    sizes.push_back(UINT16_MAX + 2);
+
+    for (size_t N: sizes)
+    {
+      // Huge boards only check the width of their genes
+      std::vector<std::vector<size_t>> batch(N > UINT16_MAX ? 3 : TEST_BATCH_BOARDS, std::vector<size_t>(N));
+      for (size_t i = 0; i < batch.size(); i ++)
+      {
+        for (size_t row = 0; row < N; row ++)
+        {
+          // First boards are the edge ones: every queen in one column and on one diagonal
+          batch[i][row] = i == 0 ? N - 1 : i == 1 ? row : random.bounded(N);
+        }
+      }
+
+      for (int isa = 0; isa <= static_cast<int>(detectFitnessIsa()); isa ++)
+        checkBatch(batch, static_cast<FitnessIsa>(isa));
+      boards += batch.size();
+    }
+  }
+
+  /** Writes the bytes into the file */
+  void writeFile(const std::string & path, const std::vector<unsigned char> & bytes)
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  }
+
+  /** Reads every record of the log, returns false if the reader refused the file with std::runtime_error */
+  bool readRunLog(const std::string & path, size_t & records)
+  {
+    try
+    {
+      RunLogReader reader(path);
+      records = reader.size();
+      for (size_t i = 0; i < reader.size(); i ++)
+      {
+        reader.getSummary(i);
+        reader.getGeneration(i);
+      }
+    }
+    catch (const std::runtime_error &)
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+  /** Expects the reader to refuse the log with the field at offset overwritten by value */
+  template <typename T>
+  void expectCorrupt(const std::string & name, std::vector<unsigned char> bytes, size_t offset, T value)
+  {
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+    writeFile(TEST_LOG_PATH, bytes);
+    size_t records = 0;
+    if (readRunLog(TEST_LOG_PATH, records))
+      fail("run log with " + name + " was read");
+  }
+
+  /** Writes a small log with populations, reads it back, then checks that truncated logs keep their whole records
+      and that corrupt headers, indexes and records are refused with std::runtime_error instead of being read out of
+      the file */
+  void checkRunLog(Random & random)
+  {
+    const size_t N = 300; // Two byte genes
+    const size_t capacity = 5;
+    const size_t records = 4;
+    std::vector<std::vector<size_t>> boards;
+    {
+      RunLogWriter writer(TEST_LOG_PATH, true);
+      writer.begin(N, capacity, TEST_SEED);
+      for (size_t index = 0; index < records; index ++)
+      {
+        Generation generation(index, 0, 0);
+        for (size_t i = 0; i < capacity - index % 2; i ++)
+        {
+          std::vector<size_t> board(N);
+          for (size_t & gene: board)
+            gene = random.bounded(N);
+          generation.addIndividual(board);
+          boards.push_back(board);
+        }
+        writer.append(generation);
+      }
+      writer.close();
+    }
+
+    std::vector<unsigned char> bytes;
+    {
+      std::ifstream file(TEST_LOG_PATH, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    /* Whole log reads back the logged genomes */
+    RunLogReader reader(TEST_LOG_PATH);
+    if (reader.size() != records || !reader.isComplete())
+      fail("run log records", boards.front(), records, reader.size());
+    size_t board = 0;
+    for (size_t index = 0; index < reader.size(); index ++)
+    {
+      Generation generation = reader.getGeneration(index);
+      for (size_t i = 0; i < generation.getPopulation().size(); i ++)
+      {
+        if (generation.getIndividual(i) != boards[board ++])
+          fail("run log genome " + std::to_string(i) + " of record " + std::to_string(index));
+      }
+    }
+
+    /* Log of an interrupted run (no footer, last record cut) keeps its whole records */
+    RunLogHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const size_t recordSize = header.recordSize;
+    for (size_t length: {sizeof(RunLogHeader), sizeof(RunLogHeader) + recordSize - 1, sizeof(RunLogHeader) + 2 * recordSize + 7})
+    {
+      writeFile(TEST_LOG_PATH, std::vector<unsigned char>(bytes.begin(), bytes.begin() + length));
+      size_t read = SIZE_MAX;
+      if (!readRunLog(TEST_LOG_PATH, read) || read != (length - sizeof(RunLogHeader)) / recordSize)
+        fail("truncated run log", boards.front(), (length - sizeof(RunLogHeader)) / recordSize, read);
+    }
+
+    const size_t footer = bytes.size() - sizeof(RunLogFooter);
+    const size_t index = footer - records * sizeof(uint64_t);
+    expectCorrupt("gene width 3", bytes, offsetof(RunLogHeader, geneWidth), uint32_t(3));
+    expectCorrupt("gene width 0", bytes, offsetof(RunLogHeader, geneWidth), uint32_t(0));
+    expectCorrupt("gene width 8", bytes, offsetof(RunLogHeader, geneWidth), uint32_t(8));
+    expectCorrupt("huge board", bytes, offsetof(RunLogHeader, dimension), uint64_t(1) << 62);
+    expectCorrupt("overflowing population", bytes, offsetof(RunLogHeader, populationCapacity), SIZE_MAX / 8);
+    expectCorrupt("short records", bytes, offsetof(RunLogHeader, recordSize), uint64_t(sizeof(RunLogRecord)));
+    expectCorrupt("wrapped index offset", bytes, footer + offsetof(RunLogFooter, indexOffset), uint64_t(0) - 8);
+    expectCorrupt("huge record count", bytes, footer + offsetof(RunLogFooter, recordCount), uint64_t(1) << 61);
+    expectCorrupt("record offset out of the file", bytes, index + 8, uint64_t(bytes.size() - 8));
+    expectCorrupt("wrapped record offset", bytes, index, uint64_t(0) - sizeof(RunLogHeader));
+    expectCorrupt("population over the capacity", bytes, sizeof(RunLogHeader) + offsetof(RunLogRecord, populationSize),
+                  uint64_t(capacity + 1));
+    expectCorrupt("gene out of the board", bytes, sizeof(RunLogHeader) + sizeof(RunLogRecord), uint16_t(N));
+
+    /* Random corruption may be read or refused, but it must not be read out of the mapping (the last record ends
+       right at the end of it) */
+    for (size_t i = 0; i < TEST_LOG_CORRUPTIONS; i ++)
+    {
+      std::vector<unsigned char> corrupt = bytes;
+      corrupt[random.bounded(corrupt.size())] ^= 1u << random.bounded(8);
+      corrupt[random.bounded(sizeof(RunLogHeader))] = random.bounded(256);
+      writeFile(TEST_LOG_PATH, corrupt);
+      size_t read = 0;
+      readRunLog(TEST_LOG_PATH, read);
+    }
+
+    std::remove(TEST_LOG_PATH);
+  }
+}
+
+/**
+ * @brief Compares the O(N) conflict counter, the specialised fitness kernels and the incremental deltas with
+ *        the pairwise O(N^2) evaluator on random and edge boards, returns 0 if all of them agree
+*/
+int main (void)
+{
+  Random random(TEST_SEED);
+  size_t boards = 0;
+
+  for (size_t N = 1; N <= TEST_MAX_SIZE; N ++)
+  {
+    /* Edge boards: every queen in one column, on the main diagonal, on the anti-diagonal and in the corners */
+    std::vector<size_t> column(N, 0);
+    std::vector<size_t> last(N, N - 1);
+    std::vector<size_t> diagonal(N);
+    std::vector<size_t> antiDiagonal(N);
+    for (size_t row = 0; row < N; row ++)
+    {
+      diagonal[row] = row;
+      antiDiagonal[row] = N - 1 - row;
+    }
+
+    for (const std::vector<size_t> & board: {column, last, diagonal, antiDiagonal})
+    {
+      checkBoard("edge", board, random, 0);
+      boards ++;
+    }
+
+    for (size_t i = 0; i < TEST_RANDOM_BOARDS; i ++)
+    {
+      std::vector<size_t> board(N);
+      for (size_t & gene: board)
+        gene = random.bounded(N);
+
+      checkBoard("random", board, random, TEST_MOVES);
+      boards ++;
+    }
+  }
+
+  size_t permutationPairs = 0;
+  checkPermutations(random, permutationPairs);
+  size_t batchBoards = 0;
+  checkBatches(random, batchBoards);
+  checkRunLog(random);
+
+  if (failures != 0)
+  {
+    std::cerr << failures << " checks failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "All " << boards << " boards match the pairwise evaluator" << std::endl;
+  std::cout << "All " << permutationPairs << " crossovers and mutations of the permutation encoding keep permutations "
+            << "and exact counters" << std::endl;
+  std::cout << "All " << batchBoards << " boards of the batch evaluator match the conflict counter (up to "
+            << fitnessIsaName(detectFitnessIsa()) << ")" << std::endl;
+  std::cout << "Corrupt run logs are refused" << std::endl;
+  return EXIT_SUCCESS;
+}
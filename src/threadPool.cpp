@@ -0,0 +1,172 @@
+/**
+ * @file threadPool.cpp
+ * @author Ondrej
+ * @brief Work-stealing pool of worker threads for parallel loops over a generation
+ *
+*/
+
+#include "threadPool.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  uint64_t pack(uint64_t begin, uint64_t end)
+  {
+    return (begin << 32) | end;
+  }
+
+  uint64_t rangeBegin(uint64_t bounds)
+  {
+    return bounds >> 32;
+  }
+
+  uint64_t rangeEnd(uint64_t bounds)
+  {
+    return bounds & 0xffffffffULL;
+  }
+}
+
+/** Creates pool with the number of workers (the thread calling parallelFor is one of them) */
+ThreadPool::ThreadPool(size_t workers)
+  : m_ranges(new Range[std::max<size_t>(workers, 1)]),
+    m_workers(std::max<size_t>(workers, 1))
+{
+  for (size_t i = 1; i < m_workers; i ++)
+  {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_stop = true;
+  lock.unlock();
+  m_start.notify_all();
+
+  for (auto & thread: m_threads)
+  {
+    thread.join();
+  }
+}
+
+/** Returns number of workers, worker indices passed to tasks are in range [0, size() - 1] */
+size_t ThreadPool::size(void) const
+{
+  return m_workers;
+}
+
+/** Calls task(index, worker) for every index in [0, count - 1] and returns after all of them finished */
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)> & task)
+{
+  /* Not worth waking the workers */
+  if (m_workers == 1 || count <= 1)
+  {
+    for (size_t i = 0; i < count; i ++)
+      task(i, 0);
+    return;
+  }
+
+  /* Every worker starts with an equal part of the range */
+  for (size_t i = 0; i < m_workers; i ++)
+  {
+    m_ranges[i].bounds.store(pack(count * i / m_workers, count * (i + 1) / m_workers), std::memory_order_relaxed);
+  }
+
+  std::unique_lock<std::mutex> lock (m_mtx);
+  m_task = &task;
+  m_running = m_workers - 1;
+  m_loop ++;
+  lock.unlock();
+  m_start.notify_all();
+
+  this -> work(0);
+
+  /* Task must not go out of scope while some worker still uses it */
+  lock.lock();
+  m_finished.wait(lock, [this] { return m_running == 0; });
+  m_task = nullptr;
+}
+
+/** Waits for parallel loops and works on them */
+void ThreadPool::workerLoop(size_t worker)
+{
+  size_t loop = 0;
+  std::unique_lock<std::mutex> lock (m_mtx);
+  while (true)
+  {
+    m_start.wait(lock, [&] { return m_stop || m_loop != loop; });
+    if (m_stop)
+      return;
+
+    loop = m_loop;
+    lock.unlock();
+
+    this -> work(worker);
+
+    lock.lock();
+    if (-- m_running == 0)
+      m_finished.notify_one();
+  }
+}
+
+/** Runs tasks of the current loop from own range and then from stolen ranges */
+void ThreadPool::work(size_t worker)
+{
+  size_t index;
+  do
+  {
+    while (this -> pop(worker, index))
+    {
+      (*m_task)(index, worker);
+    }
+  } while (this -> steal(worker));
+}
+
+/** Takes next index from own range */
+bool ThreadPool::pop(size_t worker, size_t & index)
+{
+  std::atomic<uint64_t> & bounds = m_ranges[worker].bounds;
+  uint64_t current = bounds.load(std::memory_order_acquire);
+  while (rangeBegin(current) < rangeEnd(current))
+  {
+    if (bounds.compare_exchange_weak(current, pack(rangeBegin(current) + 1, rangeEnd(current)), std::memory_order_acq_rel))
+    {
+      index = rangeBegin(current);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/** Moves half of the range of another worker to own range */
+bool ThreadPool::steal(size_t worker)
+{
+  bool workLeft = true;
+  while (workLeft)
+  {
+    workLeft = false;
+    for (size_t offset = 1; offset < m_workers; offset ++)
+    {
+      std::atomic<uint64_t> & bounds = m_ranges[(worker + offset) % m_workers].bounds;
+      uint64_t current = bounds.load(std::memory_order_acquire);
+      uint64_t begin = rangeBegin(current);
+      uint64_t end = rangeEnd(current);
+      if (begin >= end)
+        continue;
+
+      /* Victim keeps the front half (it pops from the front), thief takes the back half */
+      workLeft = true;
+      uint64_t middle = begin + (end - begin) / 2;
+      if (bounds.compare_exchange_strong(current, pack(begin, middle), std::memory_order_acq_rel))
+      {
+        m_ranges[worker].bounds.store(pack(middle, end), std::memory_order_release);
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file threadPool.hpp
+ * @author Ondrej
+ * @brief Work-stealing pool of worker threads for parallel loops over a generation
+ *
+*/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/** Runs parallel loops on a fixed set of threads. Every worker starts with an equal part of the index range and when
+    it runs out of work it steals half of the remaining range of another worker, all without locks */
+class ThreadPool
+{
+public:
+  /** Creates pool with the number of workers (the thread calling parallelFor is one of them) */
+  explicit ThreadPool(size_t workers);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /** Returns number of workers, worker indices passed to tasks are in range [0, size() - 1] */
+  size_t size(void) const;
+
+  /** Calls task(index, worker) for every index in [0, count - 1] and returns after all of them finished */
+  void parallelFor(size_t count, const std::function<void(size_t, size_t)> & task);
+
+private:
+  /** Range of indices owned by one worker, packed as (begin << 32 | end) so it can be changed by a single CAS */
+  struct alignas(64) Range
+  {
+    std::atomic<uint64_t> bounds {0};
+  };
+
+  /** Waits for parallel loops and works on them */
+  void workerLoop(size_t worker);
+
+  /** Runs tasks of the current loop from own range and then from stolen ranges */
+  void work(size_t worker);
+
+  /** Takes next index from own range */
+  bool pop(size_t worker, size_t & index);
+
+  /** Moves half of the range of another worker to own range */
+  bool steal(size_t worker);
+
+  std::vector<std::thread> m_threads;
+  std::unique_ptr<Range[]> m_ranges;
+  size_t m_workers;
+
+  std::mutex m_mtx;
+  std::condition_variable m_start;
+  std::condition_variable m_finished;
+  const std::function<void(size_t, size_t)> * m_task = nullptr;
+  size_t m_loop = 0;
+  size_t m_running = 0;
+  bool m_stop = false;
+};